@@ -0,0 +1,290 @@
+/*
+ * Batch driver: simulates every machine-code file in a directory on a pool of
+ * threads and reports the cycle count of each program. With -e simd each worker
+ * takes the files in groups of SIMDLANES and runs every group in lock step.
+ * Build: gcc -O2 -pthread -DCACHE_LIBRARY -o batch batch.c lc2ksim.c predictor.c counters.c profile.c dualissue.c ooo.c deep.c simd.c cache.c hostprof.c memtrace.c -lm
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lc2ksim.h"
+
+#define MAXPATHLENGTH 1024
+#define MAXTHREADS 256
+
+typedef struct jobStruct {
+    char path[MAXPATHLENGTH];
+    int nameOffset; // where the file name starts in path
+    int status; // 0 on success, -1 if the program couldn't be loaded or run
+    unsigned int cycles;
+    long long instructions; // for the functional engines
+    char error[MAXERRORLENGTH];
+} jobType;
+
+// Each worker owns a deque of group indices (a group is groupSize consecutive jobs). It pops from its own tail and,
+// once that is empty, steals from the head of the other workers' deques.
+typedef struct dequeStruct {
+    pthread_mutex_t lock;
+    int* jobs;
+    int head;
+    int tail;
+} dequeType;
+
+typedef struct workerStruct {
+    int id;
+    pthread_t thread;
+    int completed; // jobs it ran, failed or not
+    int stolen;
+} workerType;
+
+static jobType* jobs;
+static int numJobs;
+static dequeType deques[MAXTHREADS];
+static workerType workers[MAXTHREADS];
+static int numWorkers;
+static int engine = ENGINE_PIPELINE;
+static int groupSize = 1; // jobs a worker runs at once
+
+int compareJobs(const void*, const void*);
+int takeJob(int worker, int* stolen);
+void* workerMain(void*);
+void failJob(jobType* job, const char* error);
+int findJobs(const char* directory);
+
+int main(int argc, char *argv[]) {
+    char* directory = NULL;
+    numWorkers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "-j") && arg + 1 < argc) {
+            numWorkers = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-e") && arg + 1 < argc) {
+            engine = parseEngine(argv[++arg]);
+        } else if (directory == NULL) {
+            directory = argv[arg];
+        } else {
+            directory = NULL;
+            break;
+        }
+    }
+
+    if (directory == NULL || engine < 0) {
+        printf("error: usage: %s [-j <threads>] [-e pipeline|threaded|jit|dual|ooo|simd|deep] <directory of machine-code files>\n", argv[0]);
+        exit(1);
+    }
+    if (numWorkers < 1) numWorkers = 1;
+    if (numWorkers > MAXTHREADS) numWorkers = MAXTHREADS;
+
+    if (findJobs(directory)) {
+        exit(1);
+    }
+    if (engine == ENGINE_SIMD) groupSize = SIMDLANES;
+    int numGroups = (numJobs + groupSize - 1) / groupSize;
+    if (numWorkers > numGroups && numGroups > 0) numWorkers = numGroups;
+
+    // Deal the groups out round-robin, then let the workers balance by stealing
+    for (int w = 0; w < numWorkers; w++) {
+        pthread_mutex_init(&deques[w].lock, NULL);
+        deques[w].jobs = malloc((numGroups / numWorkers + 1) * sizeof(int));
+        if (deques[w].jobs == NULL) {
+            printf("error: out of memory\n");
+            exit(1);
+        }
+        deques[w].head = deques[w].tail = 0;
+    }
+    for (int group = 0; group < numGroups; group++) {
+        dequeType* deque = deques + group % numWorkers;
+        deque->jobs[deque->tail++] = group;
+    }
+
+    for (int w = 0; w < numWorkers; w++) {
+        workers[w].id = w;
+        if (pthread_create(&workers[w].thread, NULL, workerMain, workers + w)) {
+            printf("error: can't start worker thread %d\n", w);
+            exit(1);
+        }
+    }
+
+    int failed = 0, stolen = 0, completed = 0;
+    unsigned long long totalCycles = 0;
+    long long totalInstructions = 0;
+
+    for (int w = 0; w < numWorkers; w++) {
+        pthread_join(workers[w].thread, NULL);
+        stolen += workers[w].stolen;
+        completed += workers[w].completed;
+    }
+
+    if (completed < numJobs) {
+        // Every worker that could create its contexts ran until the deques were empty, so
+        // whatever is left there is the groups no worker was able to run
+        for (int w = 0; w < numWorkers; w++) {
+            while (deques[w].head < deques[w].tail) {
+                int first = deques[w].jobs[deques[w].head++] * groupSize;
+                for (int job = first; job < numJobs && job < first + groupSize; job++) {
+                    failJob(jobs + job, "error: out of memory");
+                }
+            }
+        }
+    }
+
+    for (int job = 0; job < numJobs; job++) {
+        if (jobs[job].status) {
+            printf("%s: %s\n", jobs[job].path + jobs[job].nameOffset, jobs[job].error);
+            failed++;
+        } else if (engine != ENGINE_THREADED && engine != ENGINE_JIT && engine != ENGINE_SIMD) {
+            printf("%s %u cycles\n", jobs[job].path + jobs[job].nameOffset, jobs[job].cycles);
+            totalCycles += jobs[job].cycles;
+        } else {
+            printf("%s %lld instructions\n", jobs[job].path + jobs[job].nameOffset, jobs[job].instructions);
+            totalInstructions += jobs[job].instructions;
+        }
+    }
+
+    printf("%d programs on %d threads (%d stolen), %d failed\n", numJobs, numWorkers, stolen, failed);
+    if (engine != ENGINE_THREADED && engine != ENGINE_JIT && engine != ENGINE_SIMD) {
+        printf("Total of %llu cycles executed\n", totalCycles);
+    } else {
+        printf("Total of %lld instructions executed\n", totalInstructions);
+    }
+
+    return failed ? 1 : 0;
+}
+
+int compareJobs(const void* a, const void* b){
+    return strcmp(((const jobType*)a)->path, ((const jobType*)b)->path); // same directory prefix
+}
+
+int findJobs(const char* directory){
+    // Collects every regular file in <directory>, sorted by name so the report is stable
+    DIR* dir = opendir(directory);
+    if (dir == NULL) {
+        printf("error: can't open directory %s\n", directory);
+        return -1;
+    }
+
+    int capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        if (numJobs == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            jobType* grown = realloc(jobs, capacity * sizeof(jobType));
+            if (grown == NULL) {
+                printf("error: out of memory\n");
+                closedir(dir);
+                return -1;
+            }
+            jobs = grown;
+        }
+
+        jobType* job = jobs + numJobs;
+        struct stat info;
+        int dirLength = snprintf(job->path, MAXPATHLENGTH, "%s/", directory);
+        snprintf(job->path + dirLength, MAXPATHLENGTH - dirLength, "%s", entry->d_name);
+        if (stat(job->path, &info) || !S_ISREG(info.st_mode)) continue;
+
+        job->nameOffset = dirLength;
+        job->status = 0;
+        numJobs++;
+    }
+    closedir(dir);
+
+    qsort(jobs, numJobs, sizeof(jobType), compareJobs);
+    return 0;
+}
+
+int takeJob(int worker, int* stolen){
+    // Returns the next group index for <worker>, or -1 once every deque is empty
+    dequeType* own = deques + worker;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->head < own->tail) {
+        int job = own->jobs[--own->tail];
+        pthread_mutex_unlock(&own->lock);
+        return job;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int offset = 1; offset < numWorkers; offset++) {
+        dequeType* victim = deques + (worker + offset) % numWorkers;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail) {
+            int job = victim->jobs[victim->head++];
+            pthread_mutex_unlock(&victim->lock);
+            (*stolen)++;
+            return job;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    return -1; // No job is ever added after start-up, so empty everywhere means done
+}
+
+void* workerMain(void* arg){
+    workerType* worker = arg;
+    simulatorType* sims[SIMDLANES];
+
+    // One context per lane, reloaded for each group
+    for (int lane = 0; lane < groupSize; lane++) {
+        sims[lane] = simulatorCreate();
+        if (sims[lane] == NULL) {
+            while (lane > 0) simulatorDestroy(sims[--lane]);
+            return NULL; // The other workers steal this worker's jobs
+        }
+        sims[lane]->traceLevel = TRACE_NONE;
+        sims[lane]->engine = engine;
+    }
+
+    int group;
+    while ((group = takeJob(worker->id, &worker->stolen)) != -1) {
+        jobType* lanes[SIMDLANES];
+        int first = group * groupSize;
+        int count = numJobs - first < groupSize ? numJobs - first : groupSize;
+        int loaded = 0;
+
+        for (int job = first; job < first + count; job++) {
+            if (simulatorLoad(sims[loaded], jobs[job].path)) {
+                failJob(jobs + job, sims[loaded]->error);
+            } else {
+                lanes[loaded++] = jobs + job;
+            }
+        }
+
+        int failed[SIMDLANES] = { 0 };
+        if (loaded == 1) failed[0] = simulatorRun(sims[0]) != 0;
+        if (loaded > 1 && runLanes(sims, loaded)) {
+            // The error is one lane's, so run each lane on its own to give every job its own outcome
+            for (int lane = 0; lane < loaded; lane++) {
+                failed[lane] = simulatorLoad(sims[lane], lanes[lane]->path) || simulatorRun(sims[lane]);
+            }
+        }
+
+        for (int lane = 0; lane < loaded; lane++) {
+            if (failed[lane]) {
+                failJob(lanes[lane], sims[lane]->error);
+            } else {
+                lanes[lane]->cycles = simulatorState(sims[lane])->cycles;
+                lanes[lane]->instructions = sims[lane]->executed;
+            }
+        }
+        worker->completed += count;
+    }
+
+    for (int lane = 0; lane < groupSize; lane++) simulatorDestroy(sims[lane]);
+    return NULL;
+}
+
+void failJob(jobType* job, const char* error){
+    job->status = -1;
+    strcpy(job->error, error);
+    job->error[strcspn(job->error, "\n")] = '\0';
+}
@@ -0,0 +1,365 @@
+/*
+ * Benchmark harness: runs every kernel in a directory (name.mc, with its expected
+ * final state in name.expected), checks the result and reports host throughput and
+ * guest CPI. Each kernel runs several times and the fastest run is reported, so
+ * numbers are comparable from one run of the harness to the next. name.expected may
+ * also list pipeline counters, which are only checked on the default pipeline (no
+ * predictor, caches or -br), as they depend on all three. A kernel may also have
+ * name.trace, the original simulator's output for it with the full trace, which
+ * the default pipeline (no predictor, caches or -br) has to reproduce byte for byte.
+ * The pipeline also runs each kernel once with the profiler on, which must not
+ * charge more cycles to instructions than the run took.
+ * Build: gcc -O2 -pthread -DCACHE_LIBRARY -o bench bench.c lc2ksim.c predictor.c counters.c profile.c dualissue.c ooo.c deep.c simd.c cache.c hostprof.c memtrace.c -lm
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lc2ksim.h"
+
+#define MAXPATHLENGTH 1024
+#define MAXNAMELENGTH 256
+#define MAXKERNELS 256
+#define MAXLINELENGTH 1000
+
+typedef struct kernelStruct {
+    char name[MAXNAMELENGTH]; // file name without .mc
+    double seconds; // fastest run
+    long long cycles;
+    long long instructions;
+    int status; // 0 if the final state matched, -1 if it didn't or the kernel couldn't run
+} kernelType;
+
+int compareKernels(const void*, const void*);
+int findKernels(const char* directory, kernelType* kernels);
+int checkState(const simulatorType* sim, const char* expectedName, int original, char* error);
+int checkTrace(simulatorType* sim, const char* programName, const char* traceName, char* error);
+int checkProfile(simulatorType* sim, const char* programName, char* error);
+double now(void);
+
+int main(int argc, char *argv[]) {
+    static kernelType kernels[MAXKERNELS];
+    char* directory = "benchmarks";
+    int repeats = 5;
+    int engine = ENGINE_PIPELINE;
+    int predictor = PREDICT_NONE;
+    int resolveStage = RESOLVE_MEM;
+    cacheConfigType icache = { 0 }, dcache = { 0 };
+    int memLatency = 0;
+    depthConfigType depth = { 1, 1, 1 };
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "-e") && arg + 1 < argc) {
+            engine = parseEngine(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-b") && arg + 1 < argc) {
+            predictor = parsePredictor(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-br") && arg + 1 < argc) {
+            resolveStage = parseResolveStage(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-n") && arg + 1 < argc) {
+            repeats = atoi(argv[++arg]);
+        } else if ((!strcmp(argv[arg], "-ic") || !strcmp(argv[arg], "-dc")) && arg + 3 < argc) {
+            cacheConfigType* config = argv[arg][1] == 'i' ? &icache : &dcache;
+            config->blockSize = atoi(argv[++arg]);
+            config->numSets = atoi(argv[++arg]);
+            config->blocksPerSet = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-depth") && arg + 3 < argc) {
+            depth.fetchStages = atoi(argv[++arg]);
+            depth.executeStages = atoi(argv[++arg]);
+            depth.memoryStages = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-l") && arg + 1 < argc) {
+            memLatency = atoi(argv[++arg]);
+        } else if (argv[arg][0] != '-') {
+            directory = argv[arg];
+        } else {
+            engine = -1;
+            break;
+        }
+    }
+
+    if (engine < 0 || predictor < 0 || resolveStage < 0 || repeats < 1 || memLatency < 0
+        || ((engine == ENGINE_DUAL || engine == ENGINE_OOO) // no caches and a fixed resolution stage
+            && (icache.blockSize || dcache.blockSize || memLatency || resolveStage != RESOLVE_MEM))
+        || (engine == ENGINE_DEEP && (icache.blockSize || dcache.blockSize || memLatency))) {
+        printf("error: usage: %s [-e pipeline|threaded|jit|dual|ooo|simd|deep] [-b none|backward|bimodal|gshare|tournament] [-br mem|ex|id] [-ic|-dc <blockSize> <numSets> <blocksPerSet>] [-l <memory latency>] [-depth <IF> <EX> <MEM stages>] [-n <runs per kernel>] [<benchmark directory>]\n", argv[0]);
+        exit(1);
+    }
+
+    int numKernels = findKernels(directory, kernels);
+    if (numKernels < 0) {
+        exit(1);
+    }
+
+    simulatorType* sim = simulatorCreate();
+    if (sim == NULL) {
+        printf("error: out of memory\n");
+        exit(1);
+    }
+    sim->traceLevel = TRACE_NONE;
+    sim->engine = engine;
+    sim->predictor.kind = predictor;
+    sim->resolveStage = resolveStage;
+    sim->icacheConfig = icache;
+    sim->dcacheConfig = dcache;
+    sim->memLatency = memLatency;
+    sim->depth = depth;
+
+    int timed = engine != ENGINE_THREADED && engine != ENGINE_JIT && engine != ENGINE_SIMD; // engines that count cycles
+    // The pipeline as the original project built it, which the .trace files were taken from
+    int original = engine == ENGINE_PIPELINE && predictor == PREDICT_NONE && resolveStage == RESOLVE_MEM
+        && !icache.blockSize && !dcache.blockSize;
+    int failed = 0;
+    double totalSeconds = 0;
+    long long totalCycles = 0, totalInstructions = 0;
+
+    printf("%-12s %12s %12s %7s %10s %10s %10s  %s\n", "kernel", "cycles", "instrs", "CPI", "ms", "Mcycles/s", "MIPS", "result");
+
+    for (int k = 0; k < numKernels; k++) {
+        kernelType* kernel = kernels + k;
+        char path[MAXPATHLENGTH], error[MAXERRORLENGTH] = "";
+
+        kernel->seconds = -1;
+        for (int run = 0; run < repeats && !kernel->status; run++) {
+            snprintf(path, sizeof(path), "%s/%.*s.mc", directory, MAXNAMELENGTH, kernel->name);
+            if (simulatorLoad(sim, path)) {
+                strcpy(error, sim->error);
+                kernel->status = -1;
+                break;
+            }
+
+            double start = now();
+            if (simulatorRun(sim)) {
+                strcpy(error, sim->error);
+                kernel->status = -1;
+                break;
+            }
+            double seconds = now() - start;
+
+            if (kernel->seconds < 0 || seconds < kernel->seconds) kernel->seconds = seconds;
+            kernel->cycles = simulatorState(sim)->cycles;
+            kernel->instructions = timed ? sim->counters.retired : sim->executed;
+
+            if (run == 0) {
+                snprintf(path, sizeof(path), "%s/%.*s.expected", directory, MAXNAMELENGTH, kernel->name);
+                kernel->status = checkState(sim, path, original, error);
+            }
+        }
+        if (!kernel->status && original) {
+            char traceName[MAXPATHLENGTH];
+            snprintf(path, sizeof(path), "%s/%.*s.mc", directory, MAXNAMELENGTH, kernel->name);
+            snprintf(traceName, sizeof(traceName), "%s/%.*s.trace", directory, MAXNAMELENGTH, kernel->name);
+            kernel->status = checkTrace(sim, path, traceName, error);
+        }
+        if (!kernel->status && engine == ENGINE_PIPELINE) {
+            snprintf(path, sizeof(path), "%s/%.*s.mc", directory, MAXNAMELENGTH, kernel->name);
+            kernel->status = checkProfile(sim, path, error);
+        }
+
+        if (kernel->status) {
+            error[strcspn(error, "\n")] = '\0';
+            printf("%-12s %s\n", kernel->name, error);
+            failed++;
+            continue;
+        }
+
+        double seconds = kernel->seconds > 0 ? kernel->seconds : 1e-9;
+        if (timed) {
+            printf("%-12s %12lld %12lld %7.3f %10.3f %10.2f %10.2f  ok\n", kernel->name, kernel->cycles, kernel->instructions,
+                (double)kernel->cycles / kernel->instructions, kernel->seconds * 1e3, kernel->cycles / seconds / 1e6,
+                kernel->instructions / seconds / 1e6);
+        } else {
+            printf("%-12s %12s %12lld %7s %10.3f %10s %10.2f  ok\n", kernel->name, "-", kernel->instructions, "-",
+                kernel->seconds * 1e3, "-", kernel->instructions / seconds / 1e6);
+        }
+        totalSeconds += kernel->seconds;
+        totalCycles += kernel->cycles;
+        totalInstructions += kernel->instructions;
+    }
+
+    if (totalSeconds > 0 && timed) {
+        printf("%-12s %12lld %12lld %7.3f %10.3f %10.2f %10.2f\n", "total", totalCycles, totalInstructions,
+            totalInstructions ? (double)totalCycles / totalInstructions : 0.0, totalSeconds * 1e3,
+            totalCycles / totalSeconds / 1e6, totalInstructions / totalSeconds / 1e6);
+    } else if (totalSeconds > 0) {
+        printf("%-12s %12s %12lld %7s %10.3f %10s %10.2f\n", "total", "-", totalInstructions, "-", totalSeconds * 1e3, "-",
+            totalInstructions / totalSeconds / 1e6);
+    }
+    printf("%d kernels, %d failed\n", numKernels, failed);
+
+    simulatorDestroy(sim);
+    return failed ? 1 : 0;
+}
+
+double now(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+int compareKernels(const void* a, const void* b){
+    return strcmp(((const kernelType*)a)->name, ((const kernelType*)b)->name);
+}
+
+int findKernels(const char* directory, kernelType* kernels){
+    // Collects the name of every .mc file in <directory>, sorted so the report is stable
+    DIR* dir = opendir(directory);
+    if (dir == NULL) {
+        printf("error: can't open directory %s\n", directory);
+        return -1;
+    }
+
+    int numKernels = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL && numKernels < MAXKERNELS) {
+        size_t length = strlen(entry->d_name);
+        if (length < 4 || length >= MAXNAMELENGTH || strcmp(entry->d_name + length - 3, ".mc")) continue;
+
+        memcpy(kernels[numKernels].name, entry->d_name, length - 3);
+        kernels[numKernels].name[length - 3] = '\0';
+        kernels[numKernels].status = 0;
+        numKernels++;
+    }
+    closedir(dir);
+
+    qsort(kernels, numKernels, sizeof(kernelType), compareKernels);
+    return numKernels;
+}
+
+int checkState(const simulatorType* sim, const char* expectedName, int original, char* error){
+    // Compares the registers and memory words listed in <expectedName>, one "reg <n> <value>"
+    // or "mem <address> <value>" per line, and on the <original> pipeline the "counter <name>
+    // <value>" lines too. Returns 0, or -1 with <error> set.
+    const stateType* state = simulatorState(sim);
+    const countersType* counters = &sim->counters;
+    const char* counterNames[] = { "retired", "loadUseStalls", "branchStalls", "squashedSlots" };
+    const long long counterValues[] = { counters->retired, counters->loadUseStalls, counters->branchStalls, counters->squashedSlots };
+    char line[MAXLINELENGTH], kind[MAXLINELENGTH], name[MAXLINELENGTH];
+    int where, expected, checked = 0;
+    long long expectedCount;
+
+    FILE* filePtr = fopen(expectedName, "r");
+    if (filePtr == NULL) {
+        snprintf(error, MAXERRORLENGTH, "error: can't open file %s", expectedName);
+        return -1;
+    }
+
+    while (fgets(line, MAXLINELENGTH, filePtr) != NULL) {
+        if (line[0] == '#' || sscanf(line, "%s", kind) != 1) continue;
+
+        if (!strcmp(kind, "counter")) {
+            int counter = 0, numCounters = sizeof(counterNames) / sizeof(counterNames[0]);
+            int parsed = sscanf(line, "%*s %s %lld", name, &expectedCount) == 2;
+            while (parsed && counter < numCounters && strcmp(name, counterNames[counter])) counter++;
+            if (!parsed || counter == numCounters) {
+                snprintf(error, MAXERRORLENGTH, "error: bad line in %s: %s", expectedName, line);
+                fclose(filePtr);
+                return -1;
+            }
+            if (original && counterValues[counter] != expectedCount) {
+                snprintf(error, MAXERRORLENGTH, "MISMATCH: %s = %lld, expected %lld", name, counterValues[counter], expectedCount);
+                fclose(filePtr);
+                return -1;
+            }
+            continue;
+        }
+
+        if (sscanf(line, "%s %d %d", kind, &where, &expected) != 3
+            || (!strcmp(kind, "reg") ? where < 0 || where >= NUMREGS : strcmp(kind, "mem") || where < 0 || where >= NUMMEMORY)) {
+            snprintf(error, MAXERRORLENGTH, "error: bad line in %s: %s", expectedName, line);
+            fclose(filePtr);
+            return -1;
+        }
+
+        int actual = kind[0] == 'r' ? state->reg[where] : state->dataMem[where];
+        if (actual != expected) {
+            snprintf(error, MAXERRORLENGTH, "MISMATCH: %s[ %d ] = %d, expected %d", kind[0] == 'r' ? "reg" : "dataMem",
+                where, actual, expected);
+            fclose(filePtr);
+            return -1;
+        }
+        checked++;
+    }
+    fclose(filePtr);
+
+    if (checked == 0) {
+        snprintf(error, MAXERRORLENGTH, "error: nothing to check in %s", expectedName);
+        return -1;
+    }
+    return 0;
+}
+
+int checkProfile(simulatorType* sim, const char* programName, char* error){
+    // Runs <programName> again with the profiler on. Returns 0 if it charged no more
+    // cycles than the run took, or -1 with <error> set.
+    sim->profiling = 1;
+    int status = simulatorLoad(sim, programName) || simulatorRun(sim);
+    long long uncharged = status ? 0 : profileUncharged(sim);
+    sim->profiling = 0;
+
+    if (status) {
+        snprintf(error, MAXERRORLENGTH, "%s", sim->error);
+        return -1;
+    }
+    if (uncharged < 0) {
+        snprintf(error, MAXERRORLENGTH, "MISMATCH: the profile charges %lld cycles more than the run took", -uncharged);
+        return -1;
+    }
+    return 0;
+}
+
+int checkTrace(simulatorType* sim, const char* programName, const char* traceName, char* error){
+    // Runs <programName> again with the full trace on stdout captured, ending it the way the
+    // simulator does, and compares it with <traceName>. Returns 0 if they match or there is
+    // no trace file, or -1 with <error> set.
+    FILE* expected = fopen(traceName, "r");
+    if (expected == NULL) return 0;
+
+    FILE* actual = tmpfile();
+    int savedStdout = dup(STDOUT_FILENO);
+    if (actual == NULL || savedStdout < 0) {
+        snprintf(error, MAXERRORLENGTH, "error: can't capture the trace of %s", programName);
+        if (actual != NULL) fclose(actual);
+        if (savedStdout >= 0) close(savedStdout);
+        fclose(expected);
+        return -1;
+    }
+
+    fflush(stdout);
+    dup2(fileno(actual), STDOUT_FILENO);
+    sim->traceLevel = TRACE_FULL;
+    int status = simulatorLoad(sim, programName) || simulatorRun(sim);
+    if (!status) {
+        printf("Machine halted\nTotal of %d cycles executed\nFinal state of machine:\n", sim->state.cycles);
+        printState(&sim->state);
+    }
+    sim->traceLevel = TRACE_NONE;
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+
+    if (status) {
+        snprintf(error, MAXERRORLENGTH, "%s", sim->error);
+    } else {
+        // Report the first line that differs
+        char want[MAXLINELENGTH], got[MAXLINELENGTH];
+        int line = 0;
+        rewind(actual);
+        for (;;) {
+            char* wantLine = fgets(want, MAXLINELENGTH, expected);
+            char* gotLine = fgets(got, MAXLINELENGTH, actual);
+            line++;
+            if (wantLine == NULL && gotLine == NULL) break;
+            if (wantLine == NULL || gotLine == NULL || strcmp(want, got)) {
+                snprintf(error, MAXERRORLENGTH, "MISMATCH: line %d of the trace differs from %s", line, traceName);
+                status = -1;
+                break;
+            }
+        }
+    }
+    fclose(actual);
+    fclose(expected);
+    return status ? -1 : 0;
+}
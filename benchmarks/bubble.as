@@ -0,0 +1,38 @@
+        lw      0       1       base	fill n words at base in descending order, then bubble sort them ascending
+        lw      0       3       n
+init    sw      1       3       0
+        lw      0       5       one
+        add     1       5       1
+        lw      0       5       neg1
+        add     3       5       3
+        beq     3       0       start
+        beq     0       0       init
+start   lw      0       2       last
+outer   lw      0       1       base
+        beq     1       2       done
+inner   lw      1       3       0
+        lw      1       4       1
+        nor     3       3       5
+        add     5       4       5
+        lw      0       6       one
+        add     5       6       5
+        nor     5       5       5
+        lw      0       6       notSign
+        nor     5       6       5
+        beq     5       0       noswap
+        sw      1       4       0
+        sw      1       3       1
+noswap  lw      0       6       one
+        add     1       6       1
+        beq     1       2       endIn
+        beq     0       0       inner
+endIn   lw      0       6       neg1
+        add     2       6       2
+        beq     0       0       outer
+done    halt
+base    .fill   1000
+last    .fill   1127
+n       .fill   128
+one     .fill   1
+neg1    .fill   -1
+notSign .fill   2147483647
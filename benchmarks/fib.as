@@ -0,0 +1,46 @@
+        lw      0       7       stackAd	recursive fib(nArg), passing a return-site id on the stack that starts at Stack
+        lw      0       1       nArg
+        add     0       0       6
+        beq     0       0       fib
+site0   sw      0       3       result
+        halt
+fib     sw      7       6       0
+        sw      7       1       1
+        lw      0       5       two
+        add     7       5       7
+        beq     1       0       base
+        lw      0       5       one
+        beq     1       5       base
+        lw      0       5       neg1
+        add     1       5       1
+        lw      0       6       one
+        beq     0       0       fib
+site1   sw      7       3       0
+        lw      0       5       one
+        add     7       5       7
+        lw      7       1       -2
+        lw      0       5       neg2
+        add     1       5       1
+        lw      0       6       two
+        beq     0       0       fib
+site2   lw      0       5       neg1
+        add     7       5       7
+        lw      7       2       0
+        add     3       2       3
+        beq     0       0       ret
+base    add     1       0       3
+ret     lw      0       5       neg2
+        add     7       5       7
+        lw      7       6       0
+        beq     6       0       site0
+        lw      0       5       one
+        beq     6       5       site1
+        beq     0       0       site2
+nArg    .fill   20
+one     .fill   1
+two     .fill   2
+neg1    .fill   -1
+neg2    .fill   -2
+result  .fill   0
+stackAd .fill   Stack
+Stack   .fill   0
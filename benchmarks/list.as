@@ -0,0 +1,35 @@
+        lw      0       4       one	build an n-node linked list at base, then sum its values reps times
+        lw      0       6       neg1
+        lw      0       1       n
+        lw      0       2       base
+        add     0       0       3
+build   sw      2       1       0
+        sw      2       3       1
+        add     2       0       3
+        add     2       4       2
+        add     2       4       2
+        add     1       6       1
+        beq     1       0       walkAll
+        beq     0       0       build
+walkAll sw      0       3       head
+        add     0       0       7
+rep     lw      0       1       head
+walk    lw      1       5       0
+        add     7       5       7
+        lw      1       1       1
+        beq     1       0       next
+        beq     0       0       walk
+next    lw      0       5       reps
+        add     5       6       5
+        sw      0       5       reps
+        beq     5       0       done
+        beq     0       0       rep
+done    sw      0       7       result
+        halt
+one     .fill   1
+neg1    .fill   -1
+n       .fill   256
+base    .fill   1000
+head    .fill   0
+reps    .fill   200
+result  .fill   0
@@ -0,0 +1,93 @@
+        lw      0       1       aBase	C = A * B for n x n matrices at aBase, bBase and cBase, multiplying by shift-and-add
+        lw      0       2       bBase
+        lw      0       3       one
+        lw      0       4       nn
+initLp  sw      1       3       0
+        sw      2       4       0
+        lw      0       5       one
+        add     1       5       1
+        add     2       5       2
+        add     3       5       3
+        lw      0       5       neg1
+        add     4       5       4
+        beq     4       0       mm
+        beq     0       0       initLp
+mm      lw      0       1       aBase
+        sw      0       1       aRow
+        lw      0       1       cBase
+        sw      0       1       cPtr
+rowLp   lw      0       1       bBase
+        sw      0       1       bCol
+colLp   lw      0       1       aRow
+        sw      0       1       pa
+        lw      0       1       bCol
+        sw      0       1       pb
+        lw      0       1       n
+        sw      0       1       kLeft
+        add     0       0       1
+kLp     lw      0       6       pa
+        lw      6       2       0
+        lw      0       6       pb
+        lw      6       3       0
+        lw      0       4       one
+        lw      0       5       bits
+mulLp   nor     3       3       6
+        nor     4       4       7
+        nor     6       7       6
+        beq     6       0       mulSkip
+        add     1       2       1
+mulSkip add     2       2       2
+        add     4       4       4
+        lw      0       6       neg1
+        add     5       6       5
+        beq     5       0       mulDone
+        beq     0       0       mulLp
+mulDone lw      0       6       pa
+        lw      0       7       one
+        add     6       7       6
+        sw      0       6       pa
+        lw      0       6       pb
+        lw      0       7       n
+        add     6       7       6
+        sw      0       6       pb
+        lw      0       6       kLeft
+        lw      0       7       neg1
+        add     6       7       6
+        sw      0       6       kLeft
+        beq     6       0       kDone
+        beq     0       0       kLp
+kDone   lw      0       6       cPtr
+        sw      6       1       0
+        lw      0       7       one
+        add     6       7       6
+        sw      0       6       cPtr
+        lw      0       6       bCol
+        add     6       7       6
+        sw      0       6       bCol
+        lw      0       7       bEnd
+        beq     6       7       rowDone
+        beq     0       0       colLp
+rowDone lw      0       6       aRow
+        lw      0       7       n
+        add     6       7       6
+        sw      0       6       aRow
+        lw      0       7       aEnd
+        beq     6       7       done
+        beq     0       0       rowLp
+done    halt
+n       .fill   8
+nn      .fill   64
+bits    .fill   8
+one     .fill   1
+neg1    .fill   -1
+aBase   .fill   1000
+aEnd    .fill   1064
+bBase   .fill   1100
+bEnd    .fill   1108
+cBase   .fill   1200
+aRow    .fill   0
+bCol    .fill   0
+cPtr    .fill   0
+pa      .fill   0
+pb      .fill   0
+kLeft   .fill   0
@@ -0,0 +1,46 @@
+        lw      0       4       one	fill n words at srcBase, copy them to dstBase reps times, then checksum dstBase
+        lw      0       6       neg1
+        lw      0       1       n
+        lw      0       2       srcBase
+        lw      0       3       three
+        add     0       4       5
+fill    sw      2       5       0
+        add     5       3       5
+        add     2       4       2
+        add     1       6       1
+        beq     1       0       rep
+        beq     0       0       fill
+rep     lw      0       1       n
+        lw      0       2       srcBase
+        lw      0       3       dstBase
+copy    lw      2       5       0
+        sw      3       5       0
+        add     2       4       2
+        add     3       4       3
+        add     1       6       1
+        beq     1       0       next
+        beq     0       0       copy
+next    lw      0       7       reps
+        add     7       6       7
+        sw      0       7       reps
+        beq     7       0       sum
+        beq     0       0       rep
+sum     lw      0       1       n
+        lw      0       3       dstBase
+        add     0       0       7
+sloop   lw      3       5       0
+        add     7       5       7
+        add     3       4       3
+        add     1       6       1
+        beq     1       0       done
+        beq     0       0       sloop
+done    sw      0       7       result
+        halt
+one     .fill   1
+neg1    .fill   -1
+n       .fill   512
+three   .fill   3
+srcBase .fill   1000
+dstBase .fill   2000
+reps    .fill   100
+result  .fill   0
@@ -0,0 +1,31 @@
+outer   lw      0       2       mcand	product of mcand and mplier by shift-and-add, reps times
+        lw      0       3       mplier
+        lw      0       4       one
+        lw      0       5       bits
+        add     0       0       1
+loop    nor     3       3       6
+        nor     4       4       7
+        nor     6       7       6
+        beq     6       0       skip
+        add     1       2       1
+skip    add     2       2       2
+        add     4       4       4
+        lw      0       6       neg1
+        add     5       6       5
+        beq     5       0       next
+        beq     0       0       loop
+next    sw      0       1       result
+        lw      0       6       reps
+        lw      0       7       neg1
+        add     6       7       6
+        sw      0       6       reps
+        beq     6       0       done
+        beq     0       0       outer
+done    halt
+mcand   .fill   6203
+mplier  .fill   1429
+one     .fill   1
+bits    .fill   15
+neg1    .fill   -1
+reps    .fill   2000
+result  .fill   0
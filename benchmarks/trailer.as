@@ -0,0 +1,9 @@
+        lw      0       1       one	data words after halt still go down the pipeline, and EX forwards into them
+        lw      0       2       neg1
+        add     1       2       3
+        sw      0       3       result
+        add     1       1       7
+        halt
+neg1    .fill   -1
+one     .fill   1
+result  .fill   5
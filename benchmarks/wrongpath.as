@@ -0,0 +1,15 @@
+        lw      0       3       count	a taken beq mispredicts with a lw-use pair behind it, on the path it squashes
+        lw      0       4       neg1
+loop    add     3       4       3
+        beq     3       0       done
+        beq     0       0       loop
+        lw      0       1       one
+        add     1       1       2
+done    lw      0       1       one
+        add     1       1       2
+        sw      0       2       result
+        halt
+count   .fill   50
+neg1    .fill   -1
+one     .fill   1
+result  .fill   0
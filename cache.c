@@ -1,17 +1,22 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define MAX_CACHE_SIZE 256
-#define MAX_BLOCK_SIZE 256
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
-#define UNINITIALIZED_TAG -1
+#include "cache.h"
+#include "hostprof.h"
 
 // **Note** this is a preprocessor macro. This is not the same as a function.
 // Powers of 2 have exactly one 1 and the rest 0's, and 0 isn't a power of 2.
 #define is_power_of_2(val) (val && !(val & (val - 1)))
 
 
+#ifndef CACHE_LIBRARY
+
 /*
  * Accesses 1 word of memory.
  * addr is a 16-bit LC2K word address.
@@ -27,41 +32,12 @@ extern int mem_access(int addr, int write_flag, int write_data);
  */
 extern int get_num_mem_accesses(void);
 
-//Use this when calling printAction. Do not modify the enumerated type below.
-enum actionType
-{
-    cacheToProcessor,
-    processorToCache,
-    memoryToCache,
-    cacheToMemory,
-    cacheToNowhere
-};
-
-/* You may add or remove variables from these structs */
-typedef struct blockStruct
-{
-    int data[MAX_BLOCK_SIZE];
-    int dirty;
-    int lruLabel;
-    int tag;
-    int valid;
-} blockStruct;
-
-typedef struct cacheStruct
-{
-    blockStruct blocks[MAX_CACHE_SIZE];
-    int blockSize;
-    int numSets;
-    int blocksPerSet;
-    // add any variables for end-of-run stats
-} cacheStruct;
-
 /* Global Cache variable */
 cacheStruct cache;
 
+#endif
+
 typedef struct {
-    int block_bits;
-    int index_bits;
     int block_offset;
     int set_index;
     int tag;
@@ -72,21 +48,34 @@ void printAction(int, int, enum actionType);
 
 // Cache helpers
 void printCache(void);
-void reset_cache();
+void reset_cache(cacheStruct*);
 
 // Bit helpers
-int create_mask(int);
-int extract_bits(int, int, int);
-decoded_address decode(int);
-
-// Block helpers
-int block_index(decoded_address*);
-int find_first_invalid(decoded_address*);
-int find_highest_LRU(decoded_address*);
-int find_block_to_replace(decoded_address*);
-void update_LRUs(decoded_address*, int);
-void evict(int, int);
-void touch_block(blockStruct*, int);
+int log2_of(int);
+static inline decoded_address decode_geometry(const cacheStruct*, int, int, int);
+decoded_address decode(cacheStruct*, int);
+
+// Block helpers; <ways> is c->blocksPerSet, passed in so the access paths can fix it
+static inline int find_tag(const int*, int, int);
+static inline int block_index(cacheStruct*, decoded_address*, int);
+static inline int was_invalidated(cacheStruct*, decoded_address*, int);
+static inline int find_first_invalid(cacheStruct*, decoded_address*, int);
+static inline int find_highest_LRU(cacheStruct*, decoded_address*, int);
+static inline int find_block_to_replace(cacheStruct*, decoded_address*, int);
+static inline void update_LRUs(cacheStruct*, decoded_address*, int, int);
+static inline void evict(cacheStruct*, int, int, int);
+static inline void touch_block(cacheStruct*, int, int);
+
+// Access paths
+static cacheAccessFunction choose_access(const cacheStruct*);
+
+#ifndef CACHE_LIBRARY
+
+// Adapts the project's mem_access to the instance interface
+static int project_mem_access(void* context, int addr, int write_flag, int write_data)
+{
+    return mem_access(addr, write_flag, write_data);
+}
 
 
 /*
@@ -107,23 +96,14 @@ void cache_init(int blockSize, int numSets, int blocksPerSet)
         printf("error: blocks must be no larger than %d words\n", MAX_BLOCK_SIZE);
         exit(1);
     }
-    if (!is_power_of_2(blockSize)) {
-        printf("warning: blockSize %d is not a power of 2\n", blockSize);
-    }
-    if (!is_power_of_2(numSets)) {
-        printf("warning: numSets %d is not a power of 2\n", numSets);
-    }
     printf("Simulating a cache with %d total lines; each line has %d words\n",
         numSets * blocksPerSet, blockSize);
     printf("Each set in the cache contains %d lines; there are %d sets\n",
         blocksPerSet, numSets);
 
     /********************* Initialize Cache *********************/
-    cache.blockSize = blockSize;
-    cache.numSets = numSets;
-    cache.blocksPerSet = blocksPerSet;
-
-    reset_cache(); // Set all the blocks' dirty to 0, lruLabel to 0, valid to 0, and tag to -1.
+    cache_instance_init(&cache, blockSize, numSets, blocksPerSet, project_mem_access, NULL);
+    cache.printActions = 1;
 
     return;
 }
@@ -140,60 +120,225 @@ void cache_init(int blockSize, int numSets, int blocksPerSet)
  */
 int cache_access(int addr, int write_flag, int write_data)
 {
+    return cache_instance_access(&cache, addr, write_flag, write_data);
+}
 
-    decoded_address decoded = decode(addr);
-    // We have now extracted all the bits we need to do our checks for the blocks
 
+/*
+ * print end of run statistics like in the spec. **This is not required**,
+ * but is very helpful in debugging.
+ * This should be called once a halt is reached.
+ * DO NOT delete this function, or else it won't compile.
+ * DO NOT print $$$ in this function
+ */
+void printStats(void)
+{
+    printf("End of run statistics:\n");
+    return;
+}
+
+#endif
+
+/*
+ * Set up a cache instance backed by <memAccess>, without printing anything.
+ * The instance starts with printActions off.
+ */
+int cache_instance_init(cacheStruct* c, int blockSize, int numSets, int blocksPerSet, memAccessFunction memAccess, void* memContext)
+{
+    if (blockSize <= 0 || numSets <= 0 || blocksPerSet <= 0
+        || blocksPerSet * numSets > MAX_CACHE_SIZE || blockSize > MAX_BLOCK_SIZE) {
+        return -1;
+    }
+
+    c->blockSize = blockSize;
+    c->numSets = numSets;
+    c->blocksPerSet = blocksPerSet;
+    c->powerOf2 = is_power_of_2(blockSize) && is_power_of_2(numSets);
+    c->blockShift = c->powerOf2 ? log2_of(blockSize) : 0;
+    c->tagShift = c->powerOf2 ? c->blockShift + log2_of(numSets) : 0;
+    c->offsetMask = blockSize - 1;
+    c->setMask = numSets - 1;
+    c->access = choose_access(c);
+    c->memAccess = memAccess;
+    c->memContext = memContext;
+    c->printActions = 0;
+    c->bus = NULL;
+    c->busContext = NULL;
+    c->hits = 0;
+    c->misses = 0;
+    c->writebacks = 0;
+    c->coherenceMisses = 0;
+    c->upgrades = 0;
+    c->invalidations = 0;
+    c->flushes = 0;
+    c->busCycles = 0;
+
+    reset_cache(c); // Set all the blocks' dirty to 0, lruLabel to 0, valid to 0, and tag to -1.
+
+    return 0;
+}
 
-    int open_block = block_index(&decoded);
+/*
+ * The body of every access path. <ways> and <words> are the set associativity and block
+ * size, or 0 to read them from the instance; <powerOf2> says whether to decode with the
+ * shifts and masks. The paths pass constants, so each is compiled for its geometry.
+ */
+static inline __attribute__((always_inline))
+int access_geometry(cacheStruct* c, int addr, int write_flag, int write_data, int ways, int words, int powerOf2)
+{
+    HOST_TIMER_START(accessTimer);
+    HOST_TIMER_START(stepTimer);
+
+    if (!ways) ways = c->blocksPerSet;
+    if (!words) words = c->blockSize;
+
+    decoded_address decoded = decode_geometry(c, addr, ways, powerOf2);
+    // We have now extracted all the bits we need to do our checks for the blocks
+    HOST_TIMER_LAP(stepTimer, HOST_CACHE_DECODE);
+
+    int open_block = block_index(c, &decoded, ways);
     // <open_block> is the base index for our open block
+    HOST_TIMER_LAP(stepTimer, HOST_BLOCK_INDEX);
 
     if(open_block == -1){
         // Cache miss, lets find either LRU or empty block and update <open_block>
-        open_block = find_block_to_replace(&decoded);
+        c->misses++;
+        if (c->bus != NULL && was_invalidated(c, &decoded, ways)) c->coherenceMisses++;
+        open_block = find_block_to_replace(c, &decoded, ways);
+
+        int evicted = (c->tags[open_block] * c->numSets + decoded.set_index) * words;
 
-        int evicted = (cache.blocks[open_block].tag * cache.numSets + decoded.set_index) * cache.blockSize;
+        evict(c, evicted, open_block, words);
 
-        evict(evicted, open_block);
+        touch_block(c, open_block, decoded.tag);
 
-        touch_block(cache.blocks + open_block, decoded.tag);
+        int start = addr - decoded.block_offset;
 
-        int start = addr - (addr % cache.blockSize);
+        if (c->bus != NULL) {
+            // The other caches go first, so a Modified copy is flushed before we read memory
+            int shared = 0;
+            c->busCycles += c->bus(c->busContext, start, write_flag ? busReadExclusive : busRead, &shared);
+            c->shared[open_block] = !write_flag && shared;
+        }
 
-        for (int block = 0; block < cache.blockSize; block++) {
-            cache.blocks[open_block].data[block] = mem_access(start + block, 0, 0);
+        for (int block = 0; block < words; block++) {
+            c->data[open_block][block] = c->memAccess(c->memContext, start + block, 0, 0);
         }
 
-        printAction(start, cache.blockSize, memoryToCache);
+        if (c->printActions) printAction(start, words, memoryToCache);
+    } else {
+        c->hits++;
+        if (write_flag && c->bus != NULL && c->shared[open_block]) {
+            int shared;
+            c->upgrades++;
+            c->busCycles += c->bus(c->busContext, addr - decoded.block_offset, busUpgrade, &shared);
+            c->shared[open_block] = 0;
+        }
     }
 
     // At this point, our <open_block> is an index to the block we want to work with, so lets also update LRUs    
 
-    update_LRUs(&decoded, open_block);
+    update_LRUs(c, &decoded, open_block, ways);
 
     if(write_flag){
         // Write data
-        cache.blocks[open_block].data[decoded.block_offset] = write_data;
-        cache.blocks[open_block].dirty = 1;
+        c->data[open_block][decoded.block_offset] = write_data;
+        c->dirty[open_block] = 1;
+    }
+
+    if (c->printActions) printAction(addr, 1, write_flag ? processorToCache : cacheToProcessor);
+
+    int result = write_flag ? 0 : c->data[open_block][decoded.block_offset];
+    HOST_TIMER_LAP(accessTimer, HOST_CACHE_ACCESS);
+    return result;
+}
+
+#define ACCESS_PATH(ways, words) \
+    static int access_##ways##_##words(cacheStruct* c, int addr, int write_flag, int write_data) \
+    { \
+        return access_geometry(c, addr, write_flag, write_data, ways, words, 1); \
     }
 
-    printAction(addr, 1, write_flag ? processorToCache : cacheToProcessor);
+// Direct-mapped, 2, 4 and 8-way, each for any block size and for 4 and 8-word blocks
+ACCESS_PATH(1, 0) ACCESS_PATH(1, 4) ACCESS_PATH(1, 8)
+ACCESS_PATH(2, 0) ACCESS_PATH(2, 4) ACCESS_PATH(2, 8)
+ACCESS_PATH(4, 0) ACCESS_PATH(4, 4) ACCESS_PATH(4, 8)
+ACCESS_PATH(8, 0) ACCESS_PATH(8, 4) ACCESS_PATH(8, 8)
+
+static const cacheAccessFunction access_paths[4][3] = {
+    { access_1_0, access_1_4, access_1_8 },
+    { access_2_0, access_2_4, access_2_8 },
+    { access_4_0, access_4_4, access_4_8 },
+    { access_8_0, access_8_4, access_8_8 },
+};
 
-    return write_flag ? 0 : cache.blocks[open_block].data[decoded.block_offset];
+// Any associativity, power of 2 geometry
+static int access_power_of_2(cacheStruct* c, int addr, int write_flag, int write_data)
+{
+    return access_geometry(c, addr, write_flag, write_data, 0, 0, 1);
 }
 
+// Block size or set count that isn't a power of 2: decodes by dividing
+static int access_general(cacheStruct* c, int addr, int write_flag, int write_data)
+{
+    return access_geometry(c, addr, write_flag, write_data, 0, 0, 0);
+}
+
+static cacheAccessFunction choose_access(const cacheStruct* c)
+{
+    if (!c->powerOf2) return access_general;
+    if (!is_power_of_2(c->blocksPerSet) || c->blocksPerSet > 8) return access_power_of_2;
+
+    int words = c->blockSize == 4 ? 1 : c->blockSize == 8 ? 2 : 0;
+    return access_paths[log2_of(c->blocksPerSet)][words];
+}
 
 /*
- * print end of run statistics like in the spec. **This is not required**,
- * but is very helpful in debugging.
- * This should be called once a halt is reached.
- * DO NOT delete this function, or else it won't compile.
- * DO NOT print $$$ in this function
+ * Access a cache instance; same contract as cache_access.
  */
-void printStats(void)
+int cache_instance_access(cacheStruct* c, int addr, int write_flag, int write_data)
 {
-    printf("End of run statistics:\n");
-    return;
+    return c->access(c, addr, write_flag, write_data);
+}
+
+void cache_instance_print_stats(const cacheStruct* c, const char* name)
+{
+    long long accesses = c->hits + c->misses;
+    printf("%s: %lld accesses, %lld hits, %lld misses (%.2f%% hit rate), %lld writebacks\n",
+        name, accesses, c->hits, c->misses, accesses ? 100.0 * c->hits / accesses : 0.0, c->writebacks);
+    if (c->bus != NULL) {
+        printf("%s: %lld coherence misses, %lld upgrades, %lld invalidations, %lld flushes, %lld bus wait cycles\n",
+            name, c->coherenceMisses, c->upgrades, c->invalidations, c->flushes, c->busCycles);
+    }
+}
+
+int cache_instance_snoop(cacheStruct* c, int addr, enum busAction action)
+{
+    decoded_address decoded = decode(c, addr);
+    int found = block_index(c, &decoded, c->blocksPerSet);
+    if (found == -1) return 0;
+
+    int flushed = c->dirty[found];
+    if (flushed) {
+        // Modified: the requester needs our copy, so it goes to memory first
+        int start = addr - decoded.block_offset;
+        c->flushes++;
+        if (c->printActions) printAction(start, c->blockSize, cacheToMemory);
+        for (int word = 0; word < c->blockSize; word++) {
+            c->memAccess(c->memContext, start + word, 1, c->data[found][word]);
+        }
+        c->dirty[found] = 0;
+    }
+
+    if (action == busRead) {
+        c->shared[found] = 1;
+    } else {
+        c->invalidations++;
+        c->lostTags[found] = c->tags[found];
+        c->tags[found] = UNINITIALIZED_TAG;
+        c->shared[found] = 0;
+    }
+    return flushed ? 2 : 1;
 }
 
 /*
@@ -240,6 +385,8 @@ void printAction(int address, int size, enum actionType type)
  * This is for debugging only and is not graded, so you may
  * modify it, but that is not recommended.
  */
+#ifndef CACHE_LIBRARY
+
 void printCache(void)
 {
     int blockIdx;
@@ -249,15 +396,15 @@ void printCache(void)
         printf("\tset %i:\n", set);
         for (int block = 0; block < cache.blocksPerSet; ++block) {
             blockIdx = set * cache.blocksPerSet + block;
-            if(cache.blocks[set * cache.blocksPerSet + block].valid) {
+            if(cache.tags[blockIdx] != UNINITIALIZED_TAG) {
                 printf("\t\t[ %0*i ] : ( V:T | D:%c | LRU:%-*i | T:%i )\n\t\t%*s{",
                     decimalDigitsForWaysInSet, block,
-                    (cache.blocks[blockIdx].dirty) ? 'T' : 'F',
-                    decimalDigitsForWaysInSet, cache.blocks[blockIdx].lruLabel,
-                    cache.blocks[blockIdx].tag,
+                    (cache.dirty[blockIdx]) ? 'T' : 'F',
+                    decimalDigitsForWaysInSet, cache.lruLabels[blockIdx],
+                    cache.tags[blockIdx],
                     7+decimalDigitsForWaysInSet, "");
                 for (int index = 0; index < cache.blockSize; ++index) {
-                    printf(" 0x%08X", cache.blocks[blockIdx].data[index]);
+                    printf(" 0x%08X", cache.data[blockIdx][index]);
                 }
                 printf(" }\n");
             }
@@ -269,6 +416,8 @@ void printCache(void)
     printf("end cache\n");
 }
 
+#endif
+
 
 /*
   _    _ ______ _      _____  ______ _____   _____ 
@@ -281,67 +430,92 @@ void printCache(void)
 */
 
 
-int create_mask(int bits){
-    return ((1 << bits) - 1);
+int log2_of(int power_of_2){
+    // Bits below the single 1 of <power_of_2>
+    return __builtin_ctz(power_of_2);
 }
 
-int extract_bits(int original, int shift_num, int bits){
-    return ((original >> shift_num) & create_mask(bits));
-}
-
-void reset_cache(){
-    
+void reset_cache(cacheStruct* c){
     for(int block = 0; block < MAX_CACHE_SIZE; block++){
-        for(int block_data = 0; block_data < MAX_BLOCK_SIZE; block_data++){
-            cache.blocks[block].data[block_data] = 0;
-        }
-        cache.blocks[block].dirty = 0;
-        cache.blocks[block].lruLabel = 0;
-        cache.blocks[block].valid = 0;
-        cache.blocks[block].tag = UNINITIALIZED_TAG;
+        c->tags[block] = UNINITIALIZED_TAG;
+        c->lostTags[block] = UNINITIALIZED_TAG;
     }
+    memset(c->lruLabels, 0, sizeof(c->lruLabels));
+    memset(c->dirty, 0, sizeof(c->dirty));
+    memset(c->shared, 0, sizeof(c->shared));
+    memset(c->data, 0, sizeof(c->data));
 }
 
-decoded_address decode(int addr){
+
+static inline decoded_address decode_geometry(const cacheStruct* c, int addr, int ways, int powerOf2){
     decoded_address addy;
-    addy.block_bits = log2(cache.blockSize); // Take the log2 of the blockSize to calculate how many bits are needed to represent offset
-    addy.index_bits = log2(cache.numSets); // log2 of the number of sets to determine the # of bits for index
-    addy.block_offset = extract_bits(addr, 0, addy.block_bits);
-    addy.set_index = extract_bits(addr, addy.block_bits, addy.index_bits);
-    addy.tag = (addr >> (addy.block_bits + addy.index_bits));
-    addy.base = addy.set_index * cache.blocksPerSet;
+    if(powerOf2){
+        addy.block_offset = addr & c->offsetMask;
+        addy.set_index = (addr >> c->blockShift) & c->setMask;
+        addy.tag = addr >> c->tagShift;
+    } else {
+        // Same split, by dividing: addr = (tag * numSets + set_index) * blockSize + block_offset
+        int block = addr / c->blockSize;
+        addy.block_offset = addr % c->blockSize;
+        addy.set_index = block % c->numSets;
+        addy.tag = block / c->numSets;
+    }
+    addy.base = addy.set_index * ways;
 
     return addy;
 }
 
-int block_index(decoded_address* addy){
-    // Find the block with tag <tag>
-    for(int block = 0; block < cache.blocksPerSet; block++){
-        // Lets find the block if it exists, loop through blocks 0-blocksPerSet
-        blockStruct check_block = cache.blocks[addy->base + block];
-        if(check_block.valid && check_block.tag == addy->tag){
-            return (addy->base + block); // Index to the block (indexed off set_index)
-        }
+decoded_address decode(cacheStruct* c, int addr){
+    return decode_geometry(c, addr, c->blocksPerSet, c->powerOf2);
+}
+static inline int find_tag(const int* tags, int count, int tag){
+    // Index of the first of <count> tags equal to <tag>, or -1. A set's tags are contiguous,
+    // so each compare checks 8 (AVX2) or 4 (SSE2) ways at once.
+    int way = 0;
+#if defined(__AVX2__)
+    __m256i wanted8 = _mm256_set1_epi32(tag);
+    for(; way + 8 <= count; way += 8){
+        __m256i equal = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(tags + way)), wanted8);
+        int hits = _mm256_movemask_ps(_mm256_castsi256_ps(equal));
+        if(hits) return way + __builtin_ctz(hits);
+    }
+#endif
+#if defined(__SSE2__)
+    __m128i wanted4 = _mm_set1_epi32(tag);
+    for(; way + 4 <= count; way += 4){
+        __m128i equal = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(tags + way)), wanted4);
+        int hits = _mm_movemask_ps(_mm_castsi128_ps(equal));
+        if(hits) return way + __builtin_ctz(hits);
+    }
+#endif
+    for(; way < count; way++){
+        if(tags[way] == tag) return way;
     }
 
-    return -1; // Not found
+    return -1;
 }
 
-int find_first_invalid(decoded_address* addy){
-    for(int block = 0; block < cache.blocksPerSet; block++){
-        if(!cache.blocks[addy->base + block].valid){
-            return block;
-        }
-    }
+static inline int block_index(cacheStruct* c, decoded_address* addy, int ways){
+    // Find the block with tag <tag>; invalid blocks hold UNINITIALIZED_TAG, which no address has
+    int way = find_tag(c->tags + addy->base, ways, addy->tag);
+    return way == -1 ? -1 : addy->base + way; // Index to the block (indexed off set_index)
+}
 
-    return -1;
+static inline int was_invalidated(cacheStruct* c, decoded_address* addy, int ways){
+    // True if the set still remembers losing <tag> to another cache
+    return find_tag(c->lostTags + addy->base, ways, addy->tag) != -1;
 }
 
-int find_highest_LRU(decoded_address* addy){
-    int max = cache.blocks[addy->base].lruLabel, index = 0;
-    for(int block = 1; block < cache.blocksPerSet; block++){
-        if(cache.blocks[addy->base + block].lruLabel > max){
-            max = cache.blocks[addy->base + block].lruLabel;
+static inline int find_first_invalid(cacheStruct* c, decoded_address* addy, int ways){
+    return find_tag(c->tags + addy->base, ways, UNINITIALIZED_TAG);
+}
+
+static inline int find_highest_LRU(cacheStruct* c, decoded_address* addy, int ways){
+    const int* labels = c->lruLabels + addy->base;
+    int max = labels[0], index = 0;
+    for(int block = 1; block < ways; block++){
+        if(labels[block] > max){
+            max = labels[block];
             index = block;
         }
     }
@@ -349,42 +523,44 @@ int find_highest_LRU(decoded_address* addy){
     return index;
 }
 
-int find_block_to_replace(decoded_address* addy){
+static inline int find_block_to_replace(cacheStruct* c, decoded_address* addy, int ways){
     // Loop through and find the offset of the next open block or the LRU
-    int first_index = find_first_invalid(addy);
+    int first_index = find_first_invalid(c, addy, ways);
     if(first_index == -1){
         // Replace first_index with the index of the highest LRU block
-        first_index = find_highest_LRU(addy);
+        first_index = find_highest_LRU(c, addy, ways);
     }
     
     return (addy->base + first_index);
 }
 
-void update_LRUs(decoded_address* addy, int read_block){
-    // Increment ALL blocks' LRU labels (including read block)
-    for(int block = 0; block < cache.blocksPerSet; block++){
-        if(cache.blocks[addy->base + block].valid){
-            cache.blocks[addy->base + block].lruLabel++;
-        }
+static inline void update_LRUs(cacheStruct* c, decoded_address* addy, int read_block, int ways){
+    // Increment ALL valid blocks' LRU labels (including read block)
+    const int* tags = c->tags + addy->base;
+    int* labels = c->lruLabels + addy->base;
+    for(int block = 0; block < ways; block++){
+        labels[block] += tags[block] != UNINITIALIZED_TAG;
     }
 
     // THEN reset the read block's LRU label
-    cache.blocks[read_block].lruLabel = 0;
+    c->lruLabels[read_block] = 0;
 }
 
-void evict(int evicted_addr, int open_block){
-    if(!cache.blocks[open_block].valid) return;
-    printAction(evicted_addr, cache.blockSize, cache.blocks[open_block].dirty ? cacheToMemory : cacheToNowhere);
-    if (cache.blocks[open_block].dirty) {
-        for (int block = 0; block < cache.blockSize; block++) {
-            mem_access(evicted_addr + block, 1, cache.blocks[open_block].data[block]);
+static inline void evict(cacheStruct* c, int evicted_addr, int open_block, int words){
+    if(c->tags[open_block] == UNINITIALIZED_TAG) return;
+    if (c->printActions) printAction(evicted_addr, words, c->dirty[open_block] ? cacheToMemory : cacheToNowhere);
+    if (c->dirty[open_block]) {
+        c->writebacks++;
+        for (int block = 0; block < words; block++) {
+            c->memAccess(c->memContext, evicted_addr + block, 1, c->data[open_block][block]);
         }
     }
 }
 
-void touch_block(blockStruct* block, int tag){
-    // Update a block (set valid to 1, dirty to 0, and tag to tag)
-    block->dirty = 0;
-    block->valid = 1;
-    block->tag = tag;
+static inline void touch_block(cacheStruct* c, int block, int tag){
+    // Fill a block (valid with tag <tag>, clean, and not shared)
+    c->tags[block] = tag;
+    c->lostTags[block] = UNINITIALIZED_TAG;
+    c->dirty[block] = 0;
+    c->shared[block] = 0;
 }
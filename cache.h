@@ -0,0 +1,97 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+/*
+ * Cache model shared by the project driver (cache_init/cache_access on the global
+ * cache, backed by mem_access) and by the pipeline simulator, which runs separate
+ * instruction and data instances on its own memory. Build with -DCACHE_LIBRARY to
+ * leave out the project driver API and its mem_access dependency.
+ *
+ * Instances attached to a bus are kept coherent with MESI: a valid block is Modified
+ * if dirty, Shared if another cache may hold it, and Exclusive otherwise.
+ */
+
+#define MAX_CACHE_SIZE 256
+#define MAX_BLOCK_SIZE 256
+
+#define UNINITIALIZED_TAG -1
+
+//Use this when calling printAction. Do not modify the enumerated type below.
+enum actionType
+{
+    cacheToProcessor,
+    processorToCache,
+    memoryToCache,
+    cacheToMemory,
+    cacheToNowhere
+};
+
+// Coherence transactions a cache puts on its bus
+enum busAction
+{
+    busRead, // read miss: other copies drop to Shared
+    busReadExclusive, // write miss: other copies are invalidated
+    busUpgrade // write hit on a Shared block: other copies are invalidated
+};
+
+// Reads (write_flag 0) or writes one word of the memory behind a cache, like mem_access
+typedef int (*memAccessFunction)(void* context, int addr, int write_flag, int write_data);
+
+// Runs <action> for the block at <addr> against every other cache on the bus. Sets *shared
+// if one of them still holds the block, and returns the cycles the requester waited.
+typedef int (*busFunction)(void* context, int addr, enum busAction action, int* shared);
+
+struct cacheStruct;
+
+// An access path, with the same contract as cache_instance_access
+typedef int (*cacheAccessFunction)(struct cacheStruct*, int addr, int write_flag, int write_data);
+
+/* You may add or remove variables from these structs */
+
+// Block state is kept in dense arrays apart from the block data, so looking up an
+// address only reads the tags of one set. Block b of set s is entry s * blocksPerSet + b.
+typedef struct cacheStruct
+{
+    int tags[MAX_CACHE_SIZE]; // UNINITIALIZED_TAG unless the block is valid
+    int lostTags[MAX_CACHE_SIZE]; // tag lost to another cache's write, so a miss on it is a coherence miss
+    int lruLabels[MAX_CACHE_SIZE];
+    unsigned char dirty[MAX_CACHE_SIZE];
+    unsigned char shared[MAX_CACHE_SIZE]; // MESI S rather than E; only set on a bus
+    int blockSize;
+    int numSets;
+    int blocksPerSet;
+    // Geometry worked out once by cache_instance_init. The shifts and masks are only
+    // used when blockSize and numSets are both powers of 2.
+    int powerOf2;
+    int blockShift; // log2(blockSize)
+    int tagShift; // log2(blockSize * numSets)
+    int offsetMask; // blockSize - 1
+    int setMask; // numSets - 1
+    cacheAccessFunction access; // cache_instance_access specialized for this geometry
+    memAccessFunction memAccess;
+    void* memContext;
+    int printActions; // log every transfer with printAction
+    busFunction bus; // NULL unless the cache is kept coherent with others
+    void* busContext;
+    // end-of-run stats
+    long long hits;
+    long long misses;
+    long long writebacks; // dirty blocks written to memory
+    long long coherenceMisses; // misses on a block another cache's write invalidated
+    long long upgrades; // write hits on Shared blocks
+    long long invalidations; // blocks lost to another cache's write
+    long long flushes; // Modified blocks written back because another cache asked for them
+    long long busCycles; // cycles spent waiting on the bus
+    int data[MAX_CACHE_SIZE][MAX_BLOCK_SIZE]; // words of each block, only meaningful while it is valid
+} cacheStruct;
+
+// Returns 0, or -1 if the geometry doesn't fit in MAX_CACHE_SIZE blocks of MAX_BLOCK_SIZE words
+int cache_instance_init(cacheStruct*, int blockSize, int numSets, int blocksPerSet, memAccessFunction, void* memContext);
+int cache_instance_access(cacheStruct*, int addr, int write_flag, int write_data);
+void cache_instance_print_stats(const cacheStruct*, const char* name);
+
+// Applies another cache's <action> on the block at <addr>. Returns 0 if this cache doesn't
+// hold it, 1 if it held a clean copy, or 2 if it held a Modified copy and flushed it.
+int cache_instance_snoop(cacheStruct*, int addr, enum busAction action);
+
+#endif
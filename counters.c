@@ -0,0 +1,64 @@
+#include "lc2ksim.h"
+
+/*
+ * Performance counters as JSON. Every object is written on one line, so a file of
+ * periodic samples followed by the final counters can be read as JSON Lines. Stall,
+ * cache and forwarding counters are left out for engines that don't model them, rather
+ * than written as zeros that look measured.
+ */
+
+static const char* forward_to_str_map[NUMFORWARDSOURCES] = {
+    "EXMEM",
+    "MEMWB",
+    "WBEND"
+};
+
+static void printCacheJson(FILE* filePtr, const char* name, const cacheStruct* cache){
+    if (cache == NULL) return;
+    fprintf(filePtr, ",\"%s\":{\"hits\":%lld,\"misses\":%lld,\"writebacks\":%lld}",
+        name, cache->hits, cache->misses, cache->writebacks);
+}
+
+void printCountersJson(FILE* filePtr, const simulatorType* sim){
+    const countersType* counters = &sim->counters;
+    int cycles = sim->state.cycles;
+    int engine = sim->engine;
+    int resolves = engine == ENGINE_PIPELINE || engine == ENGINE_DEEP; // honour resolveStage
+    int forwards = engine == ENGINE_PIPELINE || engine == ENGINE_DUAL; // latch forwarding, not a scoreboard or ROB
+
+    fprintf(filePtr, "{\"cycles\":%d,\"retired\":%lld,\"cpi\":%.4f,\"ipc\":%.4f,\"halted\":%s",
+        cycles, counters->retired, counters->retired ? (double)cycles / counters->retired : 0.0,
+        cycles ? (double)counters->retired / cycles : 0.0, sim->halted ? "true" : "false");
+    if (resolves) fprintf(filePtr, ",\"resolveStage\":\"%s\"", resolve_to_str_map[sim->resolveStage]);
+    if (engine != ENGINE_OOO) fprintf(filePtr, ",\"loadUseStalls\":%lld", counters->loadUseStalls);
+    if (resolves) fprintf(filePtr, ",\"branchStalls\":%lld", counters->branchStalls);
+    fprintf(filePtr, ",\"squashedSlots\":%lld", counters->squashedSlots);
+    if (engine == ENGINE_PIPELINE) fprintf(filePtr, ",\"memStallCycles\":%lld", sim->memStallCycles);
+    if (engine == ENGINE_DUAL) {
+        fprintf(filePtr, ",\"dualIssues\":%lld", counters->dualIssues);
+    } else if (engine == ENGINE_OOO) {
+        fprintf(filePtr, ",\"robFullStalls\":%lld,\"storeForwards\":%lld", counters->robFullStalls, counters->storeForwards);
+    } else if (engine == ENGINE_DEEP) {
+        fprintf(filePtr, ",\"depth\":[%d,%d,%d],\"aluUseStalls\":%lld", sim->depth.fetchStages, sim->depth.executeStages,
+            sim->depth.memoryStages, counters->aluUseStalls);
+    }
+    fprintf(filePtr, ",\"branches\":%lld,\"mispredicts\":%lld",
+        sim->predictor.branches, sim->predictor.mispredicts);
+
+    if (forwards) {
+        fprintf(filePtr, ",\"forwards\":{");
+        for (int source = 0; source < NUMFORWARDSOURCES; source++) {
+            fprintf(filePtr, "%s\"%s\":%lld", source ? "," : "", forward_to_str_map[source], counters->forwards[source]);
+        }
+        fprintf(filePtr, "}");
+    }
+    fprintf(filePtr, ",\"opcodeMix\":{");
+    for (int op = ADD; op <= NOOP; op++) {
+        fprintf(filePtr, "%s\"%s\":%lld", op != ADD ? "," : "", opcode_to_str_map[op], counters->opcodeMix[op]);
+    }
+    fprintf(filePtr, "}");
+
+    printCacheJson(filePtr, "icache", sim->icache);
+    printCacheJson(filePtr, "dcache", sim->dcache);
+    fprintf(filePtr, "}\n");
+}
@@ -0,0 +1,275 @@
+#include <string.h>
+
+#include "lc2ksim.h"
+
+/*
+ * In-order pipeline of configurable depth: fetchStages of IF, one ID, executeStages of
+ * EX, memoryStages of MEM (memory is read and written in the last one) and one WB.
+ * With one stage of each it runs cycle for cycle like the 5-stage pipeline, except that
+ * it only stalls for operands an instruction really reads, where the pipeline keeps the
+ * original project's lw-use field comparison.
+ *
+ * The fixed checks of the 5-stage pipeline (lw in EX, then forwarding from each later
+ * latch) are replaced by a scoreboard. ID records every instruction that writes a
+ * register as the register's newest producer, with the cycle its result can first be
+ * forwarded: after the last EX stage for add/nor, after the last MEM stage for lw.
+ * An instruction leaves ID once the producers of its operands will be ready by the
+ * time it reaches the first EX stage, and then takes them from the scoreboard rather
+ * than the register file. A beq compared in ID needs them a cycle sooner. Squashes
+ * rebuild the scoreboard from the instructions that survive.
+ *
+ * beq is predicted in the first IF stage and resolved in ID, the last EX stage or
+ * the first MEM stage, so a mispredict throws away every stage in front of that one.
+ * Caches don't apply here.
+ */
+
+typedef struct deepSlotStruct {
+    const decodedType* decoded; // noopDecoded for a bubble
+    long long seq; // fetch order, telling producers of the same register apart
+    int pcPlus1;
+    int result; // add/nor result, lw data once it has been read
+    int address; // lw/sw
+    int storeData;
+    int eq;
+    long long readyCycle; // last cycle before the result can be forwarded
+    int predictedTaken;
+    int predictHistory;
+} deepSlotType;
+
+// The newest in-flight producer of a register; seq 0 means the register file is current
+typedef struct scoreboardEntryStruct {
+    long long seq;
+    long long readyCycle;
+    int value;
+    int load;
+} scoreboardEntryType;
+
+#define MAXDEPTH (3 * MAXSTAGES + 2)
+
+typedef struct deepStateStruct {
+    int pc;
+    long long cycles;
+    long long seq; // of the last instruction fetched
+    int reg[NUMREGS];
+    int numStages;
+    deepSlotType stage[MAXDEPTH]; // stage[0] is the first IF stage, stage[numStages - 1] WB
+    scoreboardEntryType scoreboard[NUMREGS];
+} deepStateType;
+
+static const deepSlotType bubble = { .decoded = &noopDecoded };
+
+static inline int isBubble(const deepSlotType* slot){
+    return slot->decoded == &noopDecoded;
+}
+
+// A data word fetched down a wrong path can decode as an add to a register past reg[7];
+// it is squashed before writeback, but must stay off the scoreboard
+static inline int writesRegister(const decodedType* decoded){
+    return decoded->writesReg && decoded->destReg < NUMREGS;
+}
+
+// Points the scoreboard at the youngest surviving producer of each register: the
+// instructions past ID that haven't written back yet
+static void rebuildScoreboard(deepStateType* state, int id){
+    memset(state->scoreboard, 0, sizeof(state->scoreboard));
+    for (int s = state->numStages - 2; s > id; s--) {
+        const deepSlotType* slot = state->stage + s;
+        if (!writesRegister(slot->decoded)) continue;
+        state->scoreboard[slot->decoded->destReg] = (scoreboardEntryType){ slot->seq, slot->readyCycle, slot->result,
+            slot->decoded->opcode == LW };
+    }
+}
+
+// Resolves the beq in <stage> and, if it was mispredicted, redirects fetch and squashes
+// every stage in front of it
+static void resolveIn(simulatorType* sim, deepStateType* state, int stage, int* nextPc){
+    deepSlotType* slot = state->stage + stage;
+    int target = slot->pcPlus1 + slot->decoded->offset;
+
+    resolveBranch(&sim->predictor, slot->pcPlus1 - 1, slot->eq, target, slot->predictedTaken, slot->predictHistory);
+    if (slot->eq == slot->predictedTaken) return;
+
+    *nextPc = slot->eq ? target : slot->pcPlus1;
+    for (int s = 0; s < stage; s++) {
+        state->stage[s] = bubble;
+    }
+    sim->counters.squashedSlots += stage;
+    rebuildScoreboard(state, sim->depth.fetchStages);
+}
+
+// True if the producer of <reg> won't have its result ready by the end of cycle <limit>
+static inline int waitsFor(const deepStateType* state, int reg, long long limit){
+    return state->scoreboard[reg].seq && state->scoreboard[reg].readyCycle > limit;
+}
+
+static inline int operand(const deepStateType* state, int reg){
+    return state->scoreboard[reg].seq ? state->scoreboard[reg].value : state->reg[reg];
+}
+
+static int deepStep(simulatorType* sim, deepStateType* state){
+    stateType* machine = &sim->state; // memory and decoded instructions
+    countersType* counters = &sim->counters;
+    const depthConfigType* depth = &sim->depth;
+    int id = depth->fetchStages;
+    int lastEx = id + depth->executeStages;
+    int firstMem = lastEx + 1;
+    int wb = state->numStages - 1;
+
+    if (state->stage[wb].decoded == &outsideDecoded) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: pc %d is outside memory\n", state->stage[wb].pcPlus1 - 1);
+        return -1;
+    }
+    if (state->stage[wb].decoded->opcode == HALT) {
+        counters->retired++;
+        counters->opcodeMix[HALT]++;
+        return 1;
+    }
+
+    long long cycle = ++state->cycles;
+
+    /* ---------------------- IF stage --------------------- */
+
+    // Fetched before anything resolves this cycle, so a squash can still take it
+    int nextPc = state->pc + 1;
+    state->stage[0] = bubble;
+    {
+        deepSlotType* slot = state->stage;
+        slot->decoded = 0 <= state->pc && state->pc < NUMMEMORY ? fetchDecoded(machine, state->pc) : &outsideDecoded;
+        slot->seq = ++state->seq;
+        slot->pcPlus1 = state->pc + 1;
+        if (slot->decoded->opcode == BEQ) {
+            slot->predictHistory = sim->predictor.history;
+            slot->predictedTaken = predictBranch(&sim->predictor, state->pc, &nextPc);
+        }
+    }
+
+    /* ---------------------- WB stage --------------------- */
+
+    const deepSlotType* retiring = state->stage + wb;
+    if (!isBubble(retiring)) {
+        counters->retired++;
+        counters->opcodeMix[retiring->decoded->opcode]++;
+        if (writesRegister(retiring->decoded)) {
+            state->reg[retiring->decoded->destReg] = retiring->result;
+            if (state->scoreboard[retiring->decoded->destReg].seq == retiring->seq) {
+                state->scoreboard[retiring->decoded->destReg].seq = 0;
+            }
+        }
+    }
+
+    /* --------------------- MEM stages -------------------- */
+
+    deepSlotType* access = state->stage + wb - 1;
+    if (access->decoded->opcode == LW) {
+        access->result = machine->dataMem[access->address];
+        scoreboardEntryType* entry = state->scoreboard + access->decoded->destReg;
+        if (entry->seq == access->seq) entry->value = access->result;
+    } else if (access->decoded->opcode == SW) {
+        storeWord(machine, access->address, access->storeData);
+    }
+
+    if (sim->resolveStage == RESOLVE_MEM && state->stage[firstMem].decoded->opcode == BEQ) {
+        resolveIn(sim, state, firstMem, &nextPc);
+    }
+
+    /* --------------------- EX stages --------------------- */
+
+    if (sim->resolveStage == RESOLVE_EX && state->stage[lastEx].decoded->opcode == BEQ) {
+        resolveIn(sim, state, lastEx, &nextPc);
+    }
+
+    /* ---------------------- ID stage --------------------- */
+
+    deepSlotType* slot = state->stage + id;
+    const decodedType* instr = slot->decoded;
+    int stalling = 0;
+
+    if (!isBubble(slot)) {
+        // Operands are taken on the way into the first EX stage next cycle
+        int waitA = instr->readsRegA && waitsFor(state, instr->regA, cycle);
+        int waitB = instr->readsRegB && waitsFor(state, instr->regB, cycle);
+
+        if (waitA || waitB) {
+            stalling = 1;
+            if ((waitA && state->scoreboard[instr->regA].load) || (waitB && state->scoreboard[instr->regB].load)) {
+                counters->loadUseStalls++;
+            } else {
+                counters->aluUseStalls++;
+            }
+        } else if (sim->resolveStage == RESOLVE_ID && instr->opcode == BEQ
+            && ((instr->readsRegA && waitsFor(state, instr->regA, cycle - 1))
+                || (instr->readsRegB && waitsFor(state, instr->regB, cycle - 1)))) {
+            // Comparing in ID needs the operands now rather than next cycle
+            stalling = 1;
+            counters->branchStalls++;
+        }
+    }
+
+    if (!stalling && !isBubble(slot)) {
+        int valA = operand(state, instr->regA), valB = operand(state, instr->regB);
+
+        slot->eq = valA == valB;
+        slot->address = valA + instr->offset;
+        slot->storeData = valB;
+        switch (instr->opcode) {
+            case ADD:
+            slot->result = valA + valB;
+            break;
+            case NOR:
+            slot->result = ~(valA | valB);
+            break;
+        }
+        if (writesRegister(instr)) {
+            slot->readyCycle = cycle + depth->executeStages + (instr->opcode == LW ? depth->memoryStages : 0);
+            state->scoreboard[instr->destReg] = (scoreboardEntryType){ slot->seq, slot->readyCycle, slot->result,
+                instr->opcode == LW };
+        }
+        if (sim->resolveStage == RESOLVE_ID && instr->opcode == BEQ) {
+            resolveIn(sim, state, id, &nextPc);
+        }
+    }
+
+    /* ------------------------ END ------------------------ */
+
+    if (stalling) {
+        // IF and ID hold, and a bubble goes down the pipeline behind them
+        memmove(state->stage + id + 2, state->stage + id + 1, (wb - id - 1) * sizeof(deepSlotType));
+        state->stage[id + 1] = bubble;
+    } else {
+        memmove(state->stage + 1, state->stage, wb * sizeof(deepSlotType));
+        state->pc = nextPc;
+    }
+    return 0;
+}
+
+int runDeep(simulatorType* sim){
+    stateType* machine = &sim->state;
+    const depthConfigType* depth = &sim->depth;
+    deepStateType state;
+
+    if (depth->fetchStages < 1 || depth->fetchStages > MAXSTAGES || depth->executeStages < 1
+        || depth->executeStages > MAXSTAGES || depth->memoryStages < 1 || depth->memoryStages > MAXSTAGES) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: fetch, execute and memory stage counts must be 1 to %d\n", MAXSTAGES);
+        return -1;
+    }
+
+    // Start from the architectural state with every stage empty
+    memset(&state, 0, sizeof(state));
+    state.pc = machine->pc;
+    state.cycles = machine->cycles;
+    state.numStages = depth->fetchStages + depth->executeStages + depth->memoryStages + 2;
+    memcpy(state.reg, machine->reg, sizeof(state.reg));
+    for (int s = 0; s < state.numStages; s++) {
+        state.stage[s] = bubble;
+    }
+
+    int status;
+    while (!(status = deepStep(sim, &state)));
+    if (status < 0) return -1;
+
+    machine->pc = state.pc;
+    machine->cycles = state.cycles;
+    memcpy(machine->reg, state.reg, sizeof(state.reg));
+    sim->newState = *machine;
+    return 0;
+}
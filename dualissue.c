@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "lc2ksim.h"
+
+/*
+ * 2-wide in-order variant of the pipeline. Every latch holds two slots, the older
+ * instruction in slot 0. IF tops IF/ID up to two instructions, and ID issues both
+ * unless the younger one reads the older one's result, both need the single memory
+ * port, or the older one is a halt; the younger one then issues on its own next
+ * cycle. EX forwards from both slots of every later latch, and beq resolves in MEM
+ * as in the scalar pipeline. Caches and the resolution stage don't apply here.
+ */
+
+#define WIDTH 2
+
+// One slot type serves every latch; each stage fills in the fields it produces
+typedef struct slotStruct {
+    int instr;
+    const decodedType* decoded; // noopDecoded for an empty slot
+    int pcPlus1;
+    int valA;
+    int valB;
+    int offset;
+    int branchTarget;
+    int eq;
+    int aluResult;
+    int writeData;
+    int predictedTaken;
+    int predictHistory;
+} slotType;
+
+typedef struct dualStateStruct {
+    int pc;
+    int cycles;
+    int reg[NUMREGS];
+    slotType IFID[WIDTH]; // a queue: valid slots first
+    slotType IDEX[WIDTH];
+    slotType EXMEM[WIDTH];
+    slotType MEMWB[WIDTH];
+    slotType WBEND[WIDTH];
+} dualStateType;
+
+static const slotType bubble = { .instr = NOOPINSTR, .decoded = &noopDecoded };
+
+static inline int isEmpty(const slotType* slot){
+    return slot->decoded == &noopDecoded;
+}
+
+static inline int usesMemory(const decodedType* decoded){
+    return decoded->opcode == LW || decoded->opcode == SW;
+}
+
+static inline int reads(const decodedType* instr, const decodedType* producer){
+    return producer->writesReg
+        && ((instr->readsRegA && instr->regA == producer->destReg) || (instr->readsRegB && instr->regB == producer->destReg));
+}
+
+// True if <instr> in ID needs a lw that is in EX this cycle
+static inline int loadUse(const decodedType* instr, const slotType* idex){
+    for (int lane = 0; lane < WIDTH; lane++) {
+        if (idex[lane].decoded->opcode == LW && reads(instr, idex[lane].decoded)) return 1;
+    }
+    return 0;
+}
+
+static inline void forwardFrom(const decodedType* instr, int* valA, int* valB, int* sourceA, int* sourceB,
+    const slotType* producer, int value, int source){
+    if (!producer->decoded->writesReg) return;
+
+    if (instr->readsRegA && instr->regA == producer->decoded->destReg) {
+        *valA = value;
+        *sourceA = source;
+    }
+    if (instr->readsRegB && instr->regB == producer->decoded->destReg) {
+        *valB = value;
+        *sourceB = source;
+    }
+}
+
+static inline void retire(simulatorType* sim, const slotType* slot, int* reg){
+    if (isEmpty(slot)) return;
+    sim->counters.retired++;
+    sim->counters.opcodeMix[slot->decoded->opcode]++;
+    if (slot->decoded->writesReg) {
+        reg[slot->decoded->destReg] = slot->writeData;
+    }
+}
+
+static int dualStep(simulatorType* sim, dualStateType* state, dualStateType* newState){
+    stateType* machine = &sim->state; // memory and decoded instructions
+    countersType* counters = &sim->counters;
+
+    for (int lane = 0; lane < WIDTH; lane++) {
+        if (state->MEMWB[lane].decoded == &outsideDecoded) {
+            snprintf(sim->error, MAXERRORLENGTH, "error: pc %d is outside memory\n", state->MEMWB[lane].pcPlus1 - 1);
+            return -1;
+        }
+        if (state->MEMWB[lane].decoded->opcode == HALT) {
+            // Anything older in the same latch still writes back
+            for (int older = 0; older < lane; older++) {
+                retire(sim, state->MEMWB + older, state->reg);
+            }
+            counters->retired++;
+            counters->opcodeMix[HALT]++;
+            return 1;
+        }
+    }
+
+    newState->cycles += 1;
+
+    int storePending = 0, storeAddr = 0, storeData = 0;
+
+    /* ---------------------- ID stage --------------------- */
+
+    int queued = !isEmpty(state->IFID) + !isEmpty(state->IFID + 1);
+    int issued = 0;
+
+    if (queued > 0) {
+        const decodedType* older = state->IFID[0].decoded;
+        const decodedType* younger = state->IFID[1].decoded;
+
+        if (loadUse(older, state->IDEX)) {
+            counters->loadUseStalls++;
+        } else if (queued == 1 || older->opcode == HALT || loadUse(younger, state->IDEX)
+            || reads(younger, older) || (usesMemory(older) && usesMemory(younger))) {
+            issued = 1;
+        } else {
+            issued = 2;
+            counters->dualIssues++;
+        }
+    }
+
+    for (int lane = 0; lane < WIDTH; lane++) {
+        if (lane >= issued) {
+            newState->IDEX[lane] = bubble;
+            continue;
+        }
+        slotType* slot = newState->IDEX + lane;
+        *slot = state->IFID[lane];
+        slot->valA = state->reg[slot->decoded->regA];
+        slot->valB = state->reg[slot->decoded->regB];
+        slot->offset = slot->decoded->offset;
+    }
+
+    /* ---------------------- IF stage --------------------- */
+
+    // Slots ID didn't take move to the front, then fetch fills the rest
+    int filled = queued - issued;
+    for (int lane = 0; lane < filled; lane++) {
+        newState->IFID[lane] = state->IFID[issued + lane];
+    }
+
+    int pc = state->pc;
+    int redirected = 0;
+    for (int lane = filled; lane < WIDTH; lane++) {
+        if (redirected) {
+            newState->IFID[lane] = bubble;
+            continue;
+        }
+        slotType* slot = newState->IFID + lane;
+        *slot = bubble;
+        slot->pcPlus1 = pc + 1;
+        if (pc < 0 || pc >= NUMMEMORY) {
+            slot->decoded = &outsideDecoded;
+            pc++;
+            continue;
+        }
+        slot->instr = machine->instrMem[pc];
+        slot->decoded = fetchDecoded(machine, pc);
+
+        int nextPc = pc + 1;
+        if (slot->decoded->opcode == BEQ) {
+            // A predicted-taken beq ends the fetch group
+            slot->predictHistory = sim->predictor.history;
+            slot->predictedTaken = redirected = predictBranch(&sim->predictor, pc, &nextPc);
+        }
+        pc = nextPc;
+    }
+    newState->pc = pc;
+
+    /* ---------------------- EX stage --------------------- */
+
+    for (int lane = 0; lane < WIDTH; lane++) {
+        const slotType* in = state->IDEX + lane;
+        slotType* out = newState->EXMEM + lane;
+        int valA = in->valA, valB = in->valB;
+        int sourceA = -1, sourceB = -1;
+
+        *out = *in;
+        if (!isEmpty(in) && (in->decoded->readsRegA || in->decoded->readsRegB)) {
+            // Oldest first so the youngest producer wins; slot 1 is younger than slot 0
+            for (int from = 0; from < WIDTH; from++) {
+                forwardFrom(in->decoded, &valA, &valB, &sourceA, &sourceB, state->WBEND + from, state->WBEND[from].writeData, FORWARD_WBEND);
+            }
+            for (int from = 0; from < WIDTH; from++) {
+                forwardFrom(in->decoded, &valA, &valB, &sourceA, &sourceB, state->MEMWB + from, state->MEMWB[from].writeData, FORWARD_MEMWB);
+            }
+            for (int from = 0; from < WIDTH; from++) {
+                forwardFrom(in->decoded, &valA, &valB, &sourceA, &sourceB, state->EXMEM + from, state->EXMEM[from].aluResult, FORWARD_EXMEM);
+            }
+            if (sourceA >= 0) counters->forwards[sourceA]++;
+            if (sourceB >= 0) counters->forwards[sourceB]++;
+        }
+
+        out->valB = valB;
+        out->branchTarget = in->offset + in->pcPlus1;
+        out->eq = valA == valB;
+        switch (in->decoded->opcode) {
+            case LW:
+            case SW:
+            out->aluResult = valA + in->offset;
+            break;
+            case NOR:
+            out->aluResult = ~(valA | valB);
+            break;
+            case ADD:
+            out->aluResult = valA + valB;
+            break;
+        }
+    }
+
+    /* --------------------- MEM stage --------------------- */
+
+    int squashed = 0; // a mispredicted beq in slot 0 takes slot 1 with it
+
+    for (int lane = 0; lane < WIDTH; lane++) {
+        const slotType* in = state->EXMEM + lane;
+        slotType* out = newState->MEMWB + lane;
+
+        if (squashed) {
+            *out = bubble;
+            continue;
+        }
+        *out = *in;
+        out->writeData = in->aluResult;
+
+        switch (in->decoded->opcode) {
+            case LW:
+            out->writeData = machine->dataMem[in->aluResult];
+            break;
+            case SW:
+            // ID never pairs two memory instructions, so there is at most one store
+            storePending = 1;
+            storeAddr = in->aluResult;
+            storeData = in->valB;
+            out->writeData = machine->dataMem[in->aluResult];
+            break;
+            case BEQ:
+            resolveBranch(&sim->predictor, in->pcPlus1 - 1, in->eq, in->branchTarget, in->predictedTaken, in->predictHistory);
+            if (in->eq != in->predictedTaken) {
+                newState->pc = in->eq ? in->branchTarget : in->pcPlus1;
+                for (int slot = 0; slot < WIDTH; slot++) {
+                    newState->IFID[slot] = bubble;
+                    newState->IDEX[slot] = bubble;
+                    newState->EXMEM[slot] = bubble;
+                }
+                squashed = 1;
+                counters->squashedSlots += 3 * WIDTH + (WIDTH - 1 - lane);
+            }
+            break;
+        }
+    }
+
+    /* ---------------------- WB stage --------------------- */
+
+    for (int lane = 0; lane < WIDTH; lane++) {
+        retire(sim, state->MEMWB + lane, newState->reg);
+        newState->WBEND[lane] = state->MEMWB[lane];
+    }
+
+    /* ------------------------ END ------------------------ */
+    if (storePending) {
+        storeWord(machine, storeAddr, storeData);
+    }
+    *state = *newState;
+
+    return 0;
+}
+
+int runDual(simulatorType* sim){
+    stateType* machine = &sim->state;
+    dualStateType state, newState;
+
+    // Start from the architectural state with every latch empty
+    memset(&state, 0, sizeof(state));
+    state.pc = machine->pc;
+    state.cycles = machine->cycles;
+    memcpy(state.reg, machine->reg, sizeof(state.reg));
+    for (int lane = 0; lane < WIDTH; lane++) {
+        state.IFID[lane] = state.IDEX[lane] = state.EXMEM[lane] = state.MEMWB[lane] = state.WBEND[lane] = bubble;
+    }
+    newState = state;
+
+    int status;
+    while (!(status = dualStep(sim, &state, &newState)));
+    if (status < 0) return -1;
+
+    machine->pc = state.pc;
+    machine->cycles = state.cycles;
+    memcpy(machine->reg, state.reg, sizeof(state.reg));
+    sim->newState = *machine;
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "hostprof.h"
+
+#ifdef HOST_PROFILE
+
+__thread unsigned long long hostTicks[NUMHOSTCOMPONENTS];
+__thread long long hostCalls[NUMHOSTCOMPONENTS];
+__thread long long hostTimedCalls[NUMHOSTCOMPONENTS];
+__thread long long hostClockReads[NUMHOSTCOMPONENTS];
+__thread long long hostOutliers[NUMHOSTCOMPONENTS];
+__thread long long hostReads;
+__thread int hostTiming = 1;
+
+static const char* host_to_str_map[NUMHOSTCOMPONENTS] = {
+    "IF stage",
+    "ID stage",
+    "EX stage",
+    "MEM stage",
+    "WB stage",
+    "latch copy",
+    "dataHazard",
+    "readMachineCode",
+    "printState",
+    "cache access",
+    "cache decode",
+    "block_index"
+};
+
+// Components timed inside another one, left out of the sums
+static const int host_nested[NUMHOSTCOMPONENTS] = {
+    [HOST_CACHE_ACCESS] = 1, // IF and MEM
+    [HOST_CACHE_DECODE] = 1, // cache access
+    [HOST_BLOCK_INDEX] = 1
+};
+
+// Components only timed on sampled cycles; the rest are timed on every call
+static const int host_sampled[NUMHOSTCOMPONENTS] = {
+    [HOST_IF] = 1, [HOST_ID] = 1, [HOST_EX] = 1, [HOST_MEM] = 1, [HOST_WB] = 1, [HOST_LATCHES] = 1,
+    [HOST_DATAHAZARD] = 1, [HOST_CACHE_ACCESS] = 1, [HOST_CACHE_DECODE] = 1, [HOST_BLOCK_INDEX] = 1
+};
+
+// Taken when the program starts, to convert ticks to nanoseconds over the whole run
+static unsigned long long startTicks;
+static double startSeconds;
+static double readTicks; // what reading the clock itself costs, taken off every timed call
+
+static double seconds(void){
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+__attribute__((constructor)) static void hostStart(void){
+    unsigned long long before = hostNow();
+    for (int read = 0; read < 1000; read++) {
+        (void)hostNow();
+    }
+    readTicks = (hostNow() - before) / 1001.0;
+    startSeconds = seconds();
+    startTicks = hostNow();
+}
+
+void printHostProfile(FILE* filePtr, long long cycles){
+    double wall = seconds() - startSeconds;
+    unsigned long long ticks = hostNow() - startTicks;
+    double nsPerTick = ticks ? wall * 1e9 / ticks : 1.0;
+
+    fprintf(filePtr, "host profile: %.3f ms wall, %lld simulated cycles, 1 in %d pipeline cycles timed\n",
+        wall * 1e3, cycles, HOST_SAMPLE_PERIOD);
+    double ns[NUMHOSTCOMPONENTS];
+    double total = 0, cycleTotal = 0;
+    for (int component = 0; component < NUMHOSTCOMPONENTS; component++) {
+        double ticks = hostTicks[component] - readTicks * hostClockReads[component];
+        ns[component] = (ticks > 0 ? ticks : 0) * nsPerTick;
+        if (host_nested[component]) continue;
+        total += ns[component];
+        if (host_sampled[component]) cycleTotal += ns[component];
+    }
+
+    // A sampled component's share is of the sampled cycles, the others' of the whole run
+    fprintf(filePtr, "%-16s %12s %12s %9s %12s %12s %8s\n", "component", "calls", "timed", "outliers", "timed ms", "ns/call", "share");
+    for (int component = 0; component < NUMHOSTCOMPONENTS; component++) {
+        if (hostTimedCalls[component] == 0) continue;
+        double whole = host_sampled[component] ? cycleTotal : wall * 1e9;
+        fprintf(filePtr, "%-16s %12lld %12lld %9lld %12.3f %12.2f %7.2f%% %s\n", host_to_str_map[component], hostCalls[component],
+            hostTimedCalls[component], hostOutliers[component], ns[component] * 1e-6, ns[component] / hostTimedCalls[component],
+            whole > 0 ? 100.0 * ns[component] / whole : 0.0, host_sampled[component] ? "of cycles" : "of wall");
+    }
+    fprintf(filePtr, "timed %.3f ms of %.3f ms wall (%.2f%%)\n", total * 1e-6, wall * 1e3, wall > 0 ? total / (wall * 1e7) : 0.0);
+    if (total > wall * 1e9) {
+        // The top-level intervals are disjoint, so this means overlapping timers or a bad clock conversion
+        fprintf(filePtr, "warning: the sampled components add up to more than the wall time\n");
+    }
+}
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef HOSTPROF_H
+#define HOSTPROF_H
+
+/*
+ * Host-side self-profiling: how much of the simulator's own time goes to each
+ * pipeline stage, the hazard logic, file I/O, trace output and the cache model.
+ * Compiled out unless built with -DHOST_PROFILE (and hostprof.c), so the timers
+ * cost nothing in a normal build. Times nest: IF and MEM include their cache
+ * accesses, and a cache access includes its decode and block_index. dataHazard,
+ * which runs every cycle, is split out of EX.
+ *
+ * Reading the clock around every stage would cost more than the stages, so the
+ * pipeline only times one cycle in HOST_SAMPLE_PERIOD. Calls are always counted,
+ * but the report gives the time actually sampled and each component's share of it:
+ * a timed cycle runs slower than the others, so scaling the samples up by calls over
+ * timed calls would add up to more than the run took. Every clock read inside an
+ * interval (the nested timers' included) is taken off it, and a lap more than
+ * HOST_OUTLIER_FACTOR times the component's mean so far (an interrupt, a page fault)
+ * counts as the mean.
+ */
+
+#include <stdio.h>
+
+#define HOST_IF 0
+#define HOST_ID 1
+#define HOST_EX 2
+#define HOST_MEM 3
+#define HOST_WB 4
+#define HOST_LATCHES 5 // the end-of-cycle store and latch copy
+#define HOST_DATAHAZARD 6
+#define HOST_READMACHINECODE 7
+#define HOST_PRINTSTATE 8
+#define HOST_CACHE_ACCESS 9
+#define HOST_CACHE_DECODE 10
+#define HOST_BLOCK_INDEX 11
+#define NUMHOSTCOMPONENTS 12
+
+#ifndef HOST_SAMPLE_PERIOD
+#define HOST_SAMPLE_PERIOD 61 // prime, so loops with a power-of-2 period don't alias
+#endif
+
+#define HOST_OUTLIER_FACTOR 16
+#define HOST_OUTLIER_WARMUP 8 // timed calls before a component's mean is trusted
+
+#ifdef HOST_PROFILE
+
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Per thread, so contexts running on several threads don't share counters
+extern __thread unsigned long long hostTicks[NUMHOSTCOMPONENTS];
+extern __thread long long hostCalls[NUMHOSTCOMPONENTS];
+extern __thread long long hostTimedCalls[NUMHOSTCOMPONENTS];
+extern __thread long long hostClockReads[NUMHOSTCOMPONENTS]; // each adds the cost of a clock read to the time
+extern __thread long long hostOutliers[NUMHOSTCOMPONENTS]; // laps counted as the mean instead
+extern __thread long long hostReads; // clock reads so far, to charge nested timers' reads to the outer ones
+extern __thread int hostTiming; // 0 while the timers only count calls
+
+// The TSC where there is one, nanoseconds otherwise; printHostProfile converts
+static inline unsigned long long hostNow(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000ULL + time.tv_nsec;
+#endif
+}
+
+static inline unsigned long long hostRead(void) {
+    hostReads++;
+    return hostNow();
+}
+
+// Charges one timed call of <ticks>, which took <reads> clock reads, to <component>
+static inline void hostChargeCall(int component, unsigned long long ticks, long long reads) {
+    long long timed = hostTimedCalls[component]++;
+    if (timed >= HOST_OUTLIER_WARMUP && ticks > HOST_OUTLIER_FACTOR * (hostTicks[component] / timed)) {
+        ticks = hostTicks[component] / timed;
+        reads = hostClockReads[component] / timed;
+        hostOutliers[component]++;
+    }
+    hostTicks[component] += ticks;
+    hostClockReads[component] += reads;
+}
+
+// START declares <timer>; each LAP charges the time since the last START or LAP to <component>
+#define HOST_TIMER_START(timer) \
+    unsigned long long timer = hostTiming ? hostRead() : 0; \
+    long long timer##Reads = hostReads
+#define HOST_TIMER_LAP(timer, component) do { \
+        hostCalls[component]++; \
+        if (hostTiming) { \
+            unsigned long long hostLap = hostRead(); \
+            hostChargeCall(component, hostLap - (timer), hostReads - timer##Reads); \
+            (timer) = hostLap; \
+            timer##Reads = hostReads; \
+        } \
+    } while (0)
+
+// Charges the time since the last START or LAP to <component> without counting a call
+#define HOST_TIMER_SPLIT(timer, component) do { \
+        if (hostTiming) { \
+            unsigned long long hostLap = hostRead(); \
+            hostTicks[component] += hostLap - (timer); \
+            hostClockReads[component] += hostReads - timer##Reads; \
+            (timer) = hostLap; \
+            timer##Reads = hostReads; \
+        } \
+    } while (0)
+
+// Brackets the part of a cycle that is only timed on sampled cycles
+#define HOST_SAMPLE_BEGIN(cycle) (hostTiming = (cycle) % HOST_SAMPLE_PERIOD == 0)
+#define HOST_SAMPLE_END() (hostTiming = 1)
+
+// Writes the calling thread's sampled totals, and warns if the components that don't
+// nest in another add up to more than the wall time
+void printHostProfile(FILE* filePtr, long long cycles);
+
+#else
+
+#define HOST_TIMER_START(timer) do { } while (0)
+#define HOST_TIMER_LAP(timer, component) do { } while (0)
+#define HOST_TIMER_SPLIT(timer, component) do { } while (0)
+#define HOST_SAMPLE_BEGIN(cycle) do { } while (0)
+#define HOST_SAMPLE_END() do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef LC2KIMAGE_H
+#define LC2KIMAGE_H
+
+/*
+ * Binary executable image written by the linker (linker -b) and mapped by the simulator.
+ * A header, then textSize + dataSize 32-bit words in host byte order: the same words,
+ * in the same order, as the one-per-line "0x%08X" text format.
+ */
+
+#define IMAGEMAGIC "LC2K"
+#define IMAGEVERSION 1
+
+typedef struct imageHeaderStruct {
+    char magic[4]; // IMAGEMAGIC, not null terminated
+    unsigned int version;
+    unsigned int textSize; // words
+    unsigned int dataSize; // words
+    unsigned int entry; // pc of the first instruction to run
+    unsigned int checksum; // imageChecksum of the words that follow the header
+} imageHeaderType;
+
+// 32-bit FNV-1a over the image words
+static inline unsigned int imageChecksum(const int* words, unsigned int numWords) {
+    unsigned int hash = 2166136261u;
+    const unsigned char* bytes = (const unsigned char*)words;
+    for (unsigned int i = 0; i < numWords * sizeof(int); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#endif
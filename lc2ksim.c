@@ -0,0 +1,1569 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hostprof.h"
+#include "lc2kimage.h"
+#include "lc2ksim.h"
+#include "memtrace.h"
+
+const char* opcode_to_str_map[] = {
+    "add",
+    "nor",
+    "lw",
+    "sw",
+    "beq",
+    "jalr",
+    "halt",
+    "noop"
+};
+
+const char* resolve_to_str_map[] = {
+    "mem",
+    "ex",
+    "id"
+};
+
+const decodedType noopDecoded = { .valid = 1, .opcode = NOOP };
+const decodedType outsideDecoded = { .valid = 1, .opcode = NOOP };
+
+// HELPER FUNCTIONS
+int processField(const decodedType* instr, int* valA, int* valB, const decodedType* target, int writeData);
+void dataHazard(int* valA, int* valB, stateType* state, long long forwards[NUMFORWARDSOURCES]);
+
+static int readMachineCode(simulatorType*, const char*);
+static long long runThreaded(simulatorType* sim);
+static void threadedDestroy(struct threadedStruct* threaded);
+static long long runJit(simulatorType* sim);
+static void jitDestroy(struct jitStruct* jit);
+static void unmapImage(simulatorType* sim);
+static int setupCaches(simulatorType* sim);
+static int setupProfile(simulatorType* sim);
+
+simulatorType* simulatorCreate(void){
+    simulatorType* sim = calloc(1, sizeof(simulatorType));
+    if (sim == NULL) return NULL;
+
+    // Reserved, not committed: a page is only backed once something writes it
+    sim->memory = mmap(NULL, sizeof(memoryType), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (sim->memory == MAP_FAILED) {
+        free(sim);
+        return NULL;
+    }
+    sim->traceLevel = TRACE_FULL;
+    sim->engine = ENGINE_PIPELINE;
+    sim->ooo = (oooConfigType){ .robSize = 32, .rsSize = 16, .lsqSize = 16, .width = 2,
+        .aluLatency = 1, .loadLatency = 2, .branchLatency = 1 };
+    sim->depth = (depthConfigType){ .fetchStages = 1, .executeStages = 1, .memoryStages = 1 };
+    return sim;
+}
+
+void simulatorDestroy(simulatorType* sim){
+    if (sim == NULL) return;
+    if (sim->jit != NULL) jitDestroy(sim->jit);
+    simdDestroy(sim->simd);
+    unmapImage(sim);
+    free(sim->icache);
+    free(sim->dcache);
+    free(sim->profile);
+    threadedDestroy(sim->threaded);
+    munmap(sim->memory, sizeof(memoryType));
+    free(sim);
+}
+
+// Zeroes the pages of <words> (elements of <size> bytes) set in <pages>
+static void clearPages(void* words, size_t size, pageMaskType pages){
+    for (int page = 0; page < NUMPAGES; page++) {
+        if (pages >> page & 1) memset((char*)words + ((size_t)page << PAGESHIFT) * size, 0, PAGEWORDS * size);
+    }
+}
+
+static void markRange(pageMaskType* pages, int start, int length){
+    for (int page = start >> PAGESHIFT; length > 0 && page <= (start + length - 1) >> PAGESHIFT; page++) {
+        *pages |= 1ULL << page;
+    }
+}
+
+static void resetContext(simulatorType* sim){
+    stateType* state = &sim->state;
+    memoryType* memory = sim->memory;
+
+    // Only what the last program wrote needs zeroing; a mapped image wrote its own pages
+    if (sim->imageMappings[0] == NULL) {
+        clearPages(memory->instrMem, sizeof(int), memory->written.instr);
+        clearPages(memory->dataMem, sizeof(int), memory->written.data);
+    }
+    clearPages(memory->decoded, sizeof(decodedType), memory->written.decoded);
+    memset(&memory->written, 0, sizeof(pageMapType));
+    memset(state, 0, sizeof(stateType));
+    sim->halted = 0;
+    sim->executed = 0;
+    sim->memStall = 0;
+    memset(sim->memStallOwed, 0, sizeof(sim->memStallOwed));
+    sim->memStallCycles = 0;
+    memset(&sim->counters, 0, sizeof(countersType));
+    sim->error[0] = '\0';
+    unmapImage(sim);
+    predictorReset(&sim->predictor);
+
+    state->instrMem = sim->memory->instrMem;
+    state->dataMem = sim->memory->dataMem;
+    state->decoded = sim->memory->decoded;
+    state->written = &sim->memory->written;
+}
+
+int simulatorLoad(simulatorType* sim, const char* fileName){
+    stateType* state = &sim->state;
+
+    resetContext(sim);
+
+    if (setupCaches(sim) || setupProfile(sim)) {
+        return -1;
+    }
+    HOST_TIMER_START(loadTimer);
+    int status = readMachineCode(sim, fileName);
+    HOST_TIMER_LAP(loadTimer, HOST_READMACHINECODE);
+    if (status) {
+        return -1;
+    }
+
+    /* ------------ Initialize State ------------ */
+
+    // INITIALIZE INSTRUCTIONS TO NOOP
+
+    state->IFID.instr = NOOPINSTR;
+    state->IDEX.instr = NOOPINSTR;
+    state->EXMEM.instr = NOOPINSTR;
+    state->MEMWB.instr = NOOPINSTR;
+    state->WBEND.instr = NOOPINSTR;
+
+    state->IFID.decoded = &noopDecoded;
+    state->IDEX.decoded = &noopDecoded;
+    state->EXMEM.decoded = &noopDecoded;
+    state->MEMWB.decoded = &noopDecoded;
+    state->WBEND.decoded = &noopDecoded;
+
+    /* ------------------- END ------------------ */
+
+    sim->newState = *state;
+    return 0;
+}
+
+const stateType* simulatorState(const simulatorType* sim){
+    return &sim->state;
+}
+
+int simulatorRun(simulatorType* sim){
+    if (sim->engine == ENGINE_PIPELINE) {
+        int status;
+        while (!(status = simulatorStep(sim)));
+        return status < 0 ? -1 : 0;
+    }
+    if (sim->engine == ENGINE_DUAL) {
+        if (!sim->halted && runDual(sim)) return -1;
+        sim->halted = 1;
+        return 0;
+    }
+    if (sim->engine == ENGINE_OOO) {
+        if (!sim->halted && runOoo(sim)) return -1;
+        sim->halted = 1;
+        return 0;
+    }
+    if (sim->engine == ENGINE_DEEP) {
+        if (!sim->halted && runDeep(sim)) return -1;
+        sim->halted = 1;
+        return 0;
+    }
+    if (sim->engine == ENGINE_SIMD) {
+        return runLanes(&sim, 1); // batch hands it whole groups of contexts
+    }
+
+    // Functional engines run straight to halt without per-cycle traces
+    if (!sim->halted) {
+        long long executed = sim->engine == ENGINE_JIT ? runJit(sim) : runThreaded(sim);
+        if (executed < 0) {
+            return -1;
+        }
+        sim->executed += executed;
+        sim->halted = 1;
+    }
+    return 0;
+}
+
+/*
+ * Pipeline caches. The instruction and data memories stay authoritative: the caches
+ * only decide which accesses miss, so their backing reads copy the real words and
+ * their writebacks drop the data (every sw has already reached dataMem).
+ */
+
+static int readInstrMem(void* context, int addr, int write_flag, int write_data){
+    return write_flag ? 0 : ((stateType*)context)->instrMem[addr];
+}
+
+static int readDataMem(void* context, int addr, int write_flag, int write_data){
+    return write_flag ? 0 : ((stateType*)context)->dataMem[addr];
+}
+
+static int setupCache(simulatorType* sim, cacheStruct** cache, const cacheConfigType* config,
+    memAccessFunction memAccess, const char* name){
+    if (config->blockSize == 0) {
+        free(*cache);
+        *cache = NULL;
+        return 0;
+    }
+    if (*cache == NULL && (*cache = malloc(sizeof(cacheStruct))) == NULL) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: out of memory\n");
+        return -1;
+    }
+    if (cache_instance_init(*cache, config->blockSize, config->numSets, config->blocksPerSet, memAccess, &sim->state)) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: %s geometry %d %d %d doesn't fit\n",
+            name, config->blockSize, config->numSets, config->blocksPerSet);
+        return -1;
+    }
+    return 0;
+}
+
+static int setupCaches(simulatorType* sim){
+    // Caches start cold on every load or restore, like the predictor
+    return setupCache(sim, &sim->icache, &sim->icacheConfig, readInstrMem, "I-cache")
+        || setupCache(sim, &sim->dcache, &sim->dcacheConfig, readDataMem, "D-cache");
+}
+
+static int setupProfile(simulatorType* sim){
+    if (!sim->profiling) {
+        free(sim->profile);
+        sim->profile = NULL;
+        return 0;
+    }
+    if (sim->profile == NULL && (sim->profile = malloc(NUMMEMORY * sizeof(profileEntryType))) == NULL) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: out of memory\n");
+        return -1;
+    }
+    memset(sim->profile, 0, NUMMEMORY * sizeof(profileEntryType));
+    return 0;
+}
+
+// The profile entry for <pc>, or NULL when not profiling
+static inline profileEntryType* profileEntry(simulatorType* sim, int pc){
+    return sim->profile != NULL && pc >= 0 && pc < NUMMEMORY ? sim->profile + pc : NULL;
+}
+
+static inline long long cacheTransfers(const cacheStruct* cache){
+    return cache->misses + cache->writebacks;
+}
+
+// Accesses <cache> for the instruction at <pc> and returns the stall cycles it costs:
+// memLatency per block moved, plus any wait for the bus of a multi-core run. <owner>
+// is 0 for IF and 1 for MEM; the profile is charged only for the cycles actually
+// waited, since a halt can end the run with some still owed
+static inline int cacheStall(simulatorType* sim, cacheStruct* cache, int addr, int write, int pc, int owner){
+    if (cache == NULL) return 0;
+    long long before = cacheTransfers(cache);
+    long long busBefore = cache->busCycles;
+    cache_instance_access(cache, addr, write, 0);
+
+    int stall = (cacheTransfers(cache) - before) * sim->memLatency + (cache->busCycles - busBefore);
+    sim->memStallPc[owner] = pc;
+    sim->memStallOwed[owner] = stall;
+    return stall;
+}
+
+// True if <instr> reads the register <producer> writes
+static inline int dependsOn(const decodedType* instr, const decodedType* producer){
+    return producer->writesReg
+        && ((instr->readsRegA && instr->regA == producer->destReg) || (instr->readsRegB && instr->regB == producer->destReg));
+}
+
+// The original project's lw-use check, kept so pipeline timing and traces match it: a lw
+// behind the load compares only its regA, anything else compares both register fields
+// whether it reads them or not (so a noop or halt behind "lw x 0 y" stalls too)
+static inline int loadUseHazard(const decodedType* instr, const decodedType* load){
+    return instr->opcode == LW ? instr->regA == load->destReg
+        : (instr->regA == load->destReg || instr->regB == load->destReg);
+}
+
+// Throws away the <slots> youngest instructions: IF/ID, then ID/EX, then EX/MEM
+static void squash(simulatorType* sim, int slots){
+    stateType* newState = &sim->newState;
+
+    newState->IFID.instr = NOOPINSTR;
+    newState->IFID.decoded = &noopDecoded;
+    newState->IFID.predictedTaken = 0;
+    if (slots > 1) {
+        newState->IDEX.instr = NOOPINSTR;
+        newState->IDEX.decoded = &noopDecoded;
+        newState->IDEX.predictedTaken = 0;
+    }
+    if (slots > 2) {
+        newState->EXMEM.instr = NOOPINSTR;
+        newState->EXMEM.decoded = &noopDecoded;
+        newState->EXMEM.predictedTaken = 0;
+    }
+    sim->counters.squashedSlots += slots;
+}
+
+// Resolves the beq at <pc> and, if it was mispredicted, sends fetch where it really goes
+// and squashes the <slots> instructions fetched behind it. Returns 1 on a mispredict.
+static int resolveAt(simulatorType* sim, int pc, int eq, int target, int predictedTaken, int predictHistory, int slots){
+    // Without a predictor every taken beq is a mispredict
+    resolveBranch(&sim->predictor, pc, eq, target, predictedTaken, predictHistory);
+    if (eq == predictedTaken) return 0;
+
+    sim->newState.pc = eq ? target : pc + 1;
+    squash(sim, slots);
+
+    profileEntryType* entry = profileEntry(sim, pc);
+    if (entry != NULL) entry->squashes += slots;
+    return 1;
+}
+
+int simulatorStep(simulatorType* sim){
+    stateType* state = &sim->state;
+    stateType* newState = &sim->newState;
+
+    if (state->MEMWB.decoded->opcode == HALT) {
+        if (!sim->halted) {
+            sim->counters.retired++;
+            sim->counters.opcodeMix[HALT]++;
+            profileEntryType* entry = profileEntry(sim, state->MEMWB.pcPlus1 - 1);
+            if (entry != NULL) entry->retired++;
+        }
+        sim->halted = 1;
+        return 1;
+    }
+    if (state->MEMWB.decoded == &outsideDecoded) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: pc %d is outside memory\n", state->MEMWB.pcPlus1 - 1);
+        return -1;
+    }
+
+    if (sim->sampleFile != NULL && state->cycles % sim->sampleInterval == 0) {
+        printCountersJson(sim->sampleFile, sim);
+    }
+
+    if (sim->traceLevel == TRACE_FULL) {
+        HOST_TIMER_START(printTimer);
+        printState(state);
+        HOST_TIMER_LAP(printTimer, HOST_PRINTSTATE);
+    } else if (sim->traceLevel == TRACE_SUMMARY) {
+        printSummary(state);
+    }
+
+    newState->cycles += 1;
+
+    if (sim->memStall > 0) {
+        // The whole pipeline waits on memory; nothing but the cycle count moves
+        sim->memStall--;
+        sim->memStallCycles++;
+        int owner = sim->memStallOwed[0] > 0 ? 0 : 1;
+        sim->memStallOwed[owner]--;
+        profileEntryType* entry = profileEntry(sim, sim->memStallPc[owner]);
+        if (entry != NULL) entry->memStalls++;
+        state->cycles = newState->cycles;
+        return 0;
+    }
+
+    // A store from the MEM stage, applied once every stage has read this cycle's memory
+    int storePending = 0, storeAddr = 0, storeData = 0;
+
+    HOST_SAMPLE_BEGIN(state->cycles);
+    HOST_TIMER_START(stageTimer);
+
+    /* ---------------------- IF stage --------------------- */
+
+    if (0 <= state->pc && state->pc < NUMMEMORY) {
+        sim->memStall += cacheStall(sim, sim->icache, state->pc, 0, state->pc, 0);
+        if (sim->memTrace != NULL) memTraceRecord(sim->memTrace, state->cycles, state->pc, MEMTRACE_FETCH, state->pc, 0);
+
+        newState->IFID.instr = state->instrMem[state->pc];
+        newState->IFID.decoded = fetchDecoded(state, state->pc);
+    } else {
+        newState->IFID.instr = NOOPINSTR;
+        newState->IFID.decoded = &outsideDecoded;
+    }
+    newState->IFID.pcPlus1 = state->pc + 1;
+    newState->pc = state->pc + 1;
+    newState->IFID.predictedTaken = 0;
+
+    if (newState->IFID.decoded->opcode == BEQ) {
+        newState->IFID.predictHistory = sim->predictor.history;
+        newState->IFID.predictedTaken = predictBranch(&sim->predictor, state->pc, &newState->pc);
+    }
+    HOST_TIMER_LAP(stageTimer, HOST_IF);
+
+    /* ---------------------- ID stage --------------------- */
+
+    int stalling = 0, loadUse = 0;
+    const decodedType* idInstr = state->IFID.decoded;
+
+    newState->IDEX.instr = state->IFID.instr;
+    newState->IDEX.decoded = idInstr;
+    newState->IDEX.valA = state->reg[idInstr->regA];
+    newState->IDEX.valB = state->reg[idInstr->regB];
+    newState->IDEX.offset = idInstr->offset;
+    newState->IDEX.pcPlus1 = state->IFID.pcPlus1;
+    newState->IDEX.predictedTaken = state->IFID.predictedTaken;
+    newState->IDEX.predictHistory = state->IFID.predictHistory;
+
+    switch(state->IDEX.decoded->opcode){
+        case LW:
+        {
+            // Check if our current instruction relies on something loaded, and stall if it does
+            stalling = loadUse = loadUseHazard(idInstr, state->IDEX.decoded);
+            break;
+        }
+
+    }
+
+    if(!stalling && sim->resolveStage == RESOLVE_ID && idInstr->opcode == BEQ){
+        // Comparing in ID needs the operands now: the result of an add/nor in EX or a lw
+        // in EX or MEM isn't ready, so wait for it; anything older is forwarded
+        stalling = dependsOn(idInstr, state->IDEX.decoded)
+            || (state->EXMEM.decoded->opcode == LW && dependsOn(idInstr, state->EXMEM.decoded));
+        if(!stalling){
+            processField(idInstr, &newState->IDEX.valA, &newState->IDEX.valB, state->MEMWB.decoded, state->MEMWB.writeData);
+            processField(idInstr, &newState->IDEX.valA, &newState->IDEX.valB, state->EXMEM.decoded, state->EXMEM.aluResult);
+            resolveAt(sim, state->IFID.pcPlus1 - 1, newState->IDEX.valA == newState->IDEX.valB,
+                state->IFID.pcPlus1 + idInstr->offset, state->IFID.predictedTaken, state->IFID.predictHistory, 1);
+        }
+    }
+
+    if(stalling){
+        // We need to stall
+        newState->IDEX.instr = NOOPINSTR;
+        newState->IDEX.decoded = &noopDecoded;
+        newState->IDEX.predictedTaken = 0;
+        newState->pc = state->pc;
+        newState->IFID = state->IFID;
+    }
+    HOST_TIMER_LAP(stageTimer, HOST_ID);
+
+    /* ---------------------- EX stage --------------------- */
+
+    int valA = state->IDEX.valA, valB = state->IDEX.valB; // Use variables in case of forwarding so as to not write to state
+
+    // Check for data hazards
+
+    HOST_TIMER_SPLIT(stageTimer, HOST_EX);
+    dataHazard(&valA, &valB, state, sim->counters.forwards);
+    HOST_TIMER_LAP(stageTimer, HOST_DATAHAZARD);
+
+
+    newState->EXMEM.valB = valB;
+    newState->EXMEM.branchTarget = state->IDEX.offset + state->IDEX.pcPlus1;
+
+
+    switch(state->IDEX.decoded->opcode){
+        case LW:
+        case SW:
+        newState->EXMEM.aluResult = valA + state->IDEX.offset;
+        break;
+        case NOR:
+        newState->EXMEM.aluResult = ~(valA | valB);
+        break;
+        case ADD:
+        newState->EXMEM.aluResult = valA + valB;
+        break;
+    }
+
+    newState->EXMEM.eq = (valA == valB);
+
+    newState->EXMEM.instr = state->IDEX.instr;
+    newState->EXMEM.decoded = state->IDEX.decoded;
+    newState->EXMEM.predictedTaken = state->IDEX.predictedTaken;
+    newState->EXMEM.predictHistory = state->IDEX.predictHistory;
+    newState->EXMEM.pcPlus1 = state->IDEX.pcPlus1;
+
+    int squashedId = 0; // IF/ID and ID/EX thrown away, a stall in ID with them
+
+    if(sim->resolveStage == RESOLVE_EX && state->IDEX.decoded->opcode == BEQ){
+        squashedId = resolveAt(sim, state->IDEX.pcPlus1 - 1, newState->EXMEM.eq, newState->EXMEM.branchTarget,
+            state->IDEX.predictedTaken, state->IDEX.predictHistory, 2);
+    }
+    HOST_TIMER_LAP(stageTimer, HOST_EX);
+
+    /* --------------------- MEM stage --------------------- */
+
+    newState->MEMWB.instr = state->EXMEM.instr;
+    newState->MEMWB.decoded = state->EXMEM.decoded;
+    newState->MEMWB.pcPlus1 = state->EXMEM.pcPlus1;
+
+    int mispredicted = 0;
+
+    if(state->EXMEM.decoded->opcode == BEQ && sim->resolveStage == RESOLVE_MEM){
+        // Resolve the branch, train the predictor and squash if it went the other way
+        mispredicted = resolveAt(sim, state->EXMEM.pcPlus1 - 1, state->EXMEM.eq, state->EXMEM.branchTarget,
+            state->EXMEM.predictedTaken, state->EXMEM.predictHistory, 3);
+        squashedId = mispredicted;
+    }
+
+    if(mispredicted){
+        newState->MEMWB.writeData = state->EXMEM.aluResult;
+    } else{
+        // Continue as normal
+
+        switch(state->EXMEM.decoded->opcode){
+            case LW:
+            sim->memStall += cacheStall(sim, sim->dcache, state->EXMEM.aluResult, 0, state->EXMEM.pcPlus1 - 1, 1);
+            if (sim->memTrace != NULL) {
+                memTraceRecord(sim->memTrace, state->cycles, state->EXMEM.pcPlus1 - 1, MEMTRACE_LOAD, state->EXMEM.aluResult, 0);
+            }
+            newState->MEMWB.writeData = state->dataMem[state->EXMEM.aluResult];
+            break;
+            case SW:
+            sim->memStall += cacheStall(sim, sim->dcache, state->EXMEM.aluResult, 1, state->EXMEM.pcPlus1 - 1, 1);
+            if (sim->memTrace != NULL) {
+                memTraceRecord(sim->memTrace, state->cycles, state->EXMEM.pcPlus1 - 1, MEMTRACE_STORE, state->EXMEM.aluResult,
+                    state->EXMEM.valB);
+            }
+            storePending = 1;
+            storeAddr = state->EXMEM.aluResult;
+            storeData = state->EXMEM.valB;
+            newState->MEMWB.writeData = state->dataMem[state->EXMEM.aluResult];
+            break;
+            default:
+            newState->MEMWB.writeData = state->EXMEM.aluResult;
+            break;
+        }
+    }
+    HOST_TIMER_LAP(stageTimer, HOST_MEM);
+
+    if(stalling && !squashedId){
+        // Counted once the cycle is over: a mispredict in EX or MEM squashes the stall with
+        // the slots it held, and those are already counted as squashed
+        if(loadUse) sim->counters.loadUseStalls++;
+        else sim->counters.branchStalls++;
+        profileEntryType* entry = profileEntry(sim, state->IFID.pcPlus1 - 1);
+        if (entry != NULL) entry->stalls++;
+    }
+
+    /* ---------------------- WB stage --------------------- */
+
+    newState->WBEND.writeData = state->MEMWB.writeData;
+    newState->WBEND.instr = state->MEMWB.instr;
+    newState->WBEND.decoded = state->MEMWB.decoded;
+
+    if(state->MEMWB.decoded != &noopDecoded){
+        // Bubbles from stalls and squashes point at noopDecoded; anything else retires
+        sim->counters.retired++;
+        sim->counters.opcodeMix[state->MEMWB.decoded->opcode]++;
+        profileEntryType* entry = profileEntry(sim, state->MEMWB.pcPlus1 - 1);
+        if (entry != NULL) entry->retired++;
+    }
+
+    if(state->MEMWB.decoded->writesReg){
+        newState->reg[state->MEMWB.decoded->destReg] = state->MEMWB.writeData;
+    }
+    HOST_TIMER_LAP(stageTimer, HOST_WB);
+
+    /* ------------------------ END ------------------------ */
+    if (storePending) {
+        storeWord(state, storeAddr, storeData);
+    }
+    *state = *newState; /* this is the last statement before end of the loop. It marks the end
+    of the cycle and updates the current state with the values calculated in this cycle */
+    HOST_TIMER_LAP(stageTimer, HOST_LATCHES);
+    HOST_SAMPLE_END();
+
+    return 0;
+}
+
+/*
+ * Checkpoint file layout, all integers in host byte order:
+ *   "LC2KCKPT", version, numMemory, cycles, pc, halted, resolveStage, executed (64-bit),
+ *   reg[NUMREGS], the latch fields in the order of checkpointLatches,
+ *   then instrMem and dataMem as runs of nonzero words: (start, length, words...)
+ *   each, ended by a run of length 0. Only written pages are scanned for runs.
+ * Branch predictor tables, cache contents, the profile and pending memory stalls are not
+ * saved, so a restored run starts with a cold predictor and cold caches. The branch
+ * resolution stage is saved because the latches may hold beqs that are only resolved
+ * further down.
+ */
+
+#define CHECKPOINTMAGIC "LC2KCKPT"
+#define CHECKPOINTVERSION 4
+#define NUMHEADERFIELDS 6
+#define NUMLATCHFIELDS 24
+
+static void checkpointLatches(stateType* state, int* fields[NUMLATCHFIELDS]){
+    int* order[NUMLATCHFIELDS] = {
+        &state->IFID.instr, &state->IFID.pcPlus1, &state->IFID.predictedTaken, &state->IFID.predictHistory,
+        &state->IDEX.instr, &state->IDEX.pcPlus1, &state->IDEX.valA, &state->IDEX.valB, &state->IDEX.offset,
+        &state->IDEX.predictedTaken, &state->IDEX.predictHistory,
+        &state->EXMEM.instr, &state->EXMEM.branchTarget, &state->EXMEM.eq, &state->EXMEM.aluResult, &state->EXMEM.valB,
+        &state->EXMEM.predictedTaken, &state->EXMEM.predictHistory, &state->EXMEM.pcPlus1,
+        &state->MEMWB.instr, &state->MEMWB.writeData, &state->MEMWB.pcPlus1,
+        &state->WBEND.instr, &state->WBEND.writeData
+    };
+    memcpy(fields, order, sizeof(order));
+}
+
+static void writeSparse(FILE* filePtr, const int* words, pageMaskType pages){
+    int start = 0;
+    while (start < NUMMEMORY) {
+        if (!(pages >> (start >> PAGESHIFT) & 1)) {
+            start = (start | (PAGEWORDS - 1)) + 1; // never written, so all 0
+            continue;
+        }
+        if (!words[start]) {
+            start++;
+            continue;
+        }
+        int length = 0;
+        while (start + length < NUMMEMORY && words[start + length]) length++;
+
+        fwrite(&start, sizeof(int), 1, filePtr);
+        fwrite(&length, sizeof(int), 1, filePtr);
+        fwrite(words + start, sizeof(int), length, filePtr);
+        start += length;
+    }
+    int end[2] = { 0, 0 };
+    fwrite(end, sizeof(int), 2, filePtr);
+}
+
+static int readSparse(FILE* filePtr, int* words, pageMaskType* pages){
+    int run[2];
+    while (fread(run, sizeof(int), 2, filePtr) == 2) {
+        if (run[1] == 0) return 0;
+        if (run[0] < 0 || run[1] < 0 || run[0] + run[1] > NUMMEMORY) return -1;
+        if (fread(words + run[0], sizeof(int), run[1], filePtr) != (size_t)run[1]) return -1;
+        markRange(pages, run[0], run[1]);
+    }
+    return -1;
+}
+
+int simulatorSave(simulatorType* sim, const char* fileName){
+    stateType* state = &sim->state;
+    int* latches[NUMLATCHFIELDS];
+    int header[NUMHEADERFIELDS] = { CHECKPOINTVERSION, state->numMemory, state->cycles, state->pc, sim->halted, sim->resolveStage };
+
+    FILE* filePtr = fopen(fileName, "wb");
+    if (filePtr == NULL) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: can't open file %s\n", fileName);
+        return -1;
+    }
+
+    fwrite(CHECKPOINTMAGIC, 1, strlen(CHECKPOINTMAGIC), filePtr);
+    fwrite(header, sizeof(int), NUMHEADERFIELDS, filePtr);
+    fwrite(&sim->executed, sizeof(long long), 1, filePtr);
+    fwrite(state->reg, sizeof(int), NUMREGS, filePtr);
+    checkpointLatches(state, latches);
+    for (int field = 0; field < NUMLATCHFIELDS; field++) {
+        fwrite(latches[field], sizeof(int), 1, filePtr);
+    }
+    writeSparse(filePtr, state->instrMem, state->written->instr);
+    writeSparse(filePtr, state->dataMem, state->written->data);
+
+    if (fclose(filePtr)) {
+        snprintf(sim->error, MAXERRORLENGTH, "error in writing checkpoint %s\n", fileName);
+        return -1;
+    }
+    return 0;
+}
+
+int simulatorRestore(simulatorType* sim, const char* fileName){
+    stateType* state = &sim->state;
+    int* latches[NUMLATCHFIELDS];
+    char magic[sizeof(CHECKPOINTMAGIC)] = "";
+    int header[NUMHEADERFIELDS];
+
+    FILE* filePtr = fopen(fileName, "rb");
+    if (filePtr == NULL) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: can't open file %s\n", fileName);
+        return -1;
+    }
+
+    resetContext(sim);
+    if (setupCaches(sim) || setupProfile(sim)) {
+        fclose(filePtr);
+        return -1;
+    }
+
+    int ok = fread(magic, 1, strlen(CHECKPOINTMAGIC), filePtr) == strlen(CHECKPOINTMAGIC)
+        && !strcmp(magic, CHECKPOINTMAGIC)
+        && fread(header, sizeof(int), NUMHEADERFIELDS, filePtr) == NUMHEADERFIELDS
+        && header[0] == CHECKPOINTVERSION
+        && header[5] >= RESOLVE_MEM && header[5] <= RESOLVE_ID
+        && fread(&sim->executed, sizeof(long long), 1, filePtr) == 1
+        && fread(state->reg, sizeof(int), NUMREGS, filePtr) == NUMREGS;
+
+    checkpointLatches(state, latches);
+    for (int field = 0; ok && field < NUMLATCHFIELDS; field++) {
+        ok = fread(latches[field], sizeof(int), 1, filePtr) == 1;
+    }
+    ok = ok && !readSparse(filePtr, state->instrMem, &state->written->instr)
+        && !readSparse(filePtr, state->dataMem, &state->written->data);
+    fclose(filePtr);
+
+    if (!ok) {
+        snprintf(sim->error, MAXERRORLENGTH, "error in reading checkpoint %s\n", fileName);
+        return -1;
+    }
+
+    state->numMemory = header[1];
+    state->cycles = header[2];
+    state->pc = header[3];
+    sim->halted = header[4];
+    sim->resolveStage = header[5];
+
+    // Latches point at their own decoded copies, since a latched word can be anything
+    int* latchInstrs[5] = { &state->IFID.instr, &state->IDEX.instr, &state->EXMEM.instr, &state->MEMWB.instr, &state->WBEND.instr };
+    for (int latch = 0; latch < 5; latch++) {
+        decodeInstruction(*latchInstrs[latch], sim->restored + latch);
+    }
+    state->IFID.decoded = sim->restored + 0;
+    state->IDEX.decoded = sim->restored + 1;
+    state->EXMEM.decoded = sim->restored + 2;
+    state->MEMWB.decoded = sim->restored + 3;
+    state->WBEND.decoded = sim->restored + 4;
+
+    sim->newState = *state;
+    return 0;
+}
+
+long long simulatorFastForward(simulatorType* sim, long long maxInstrs, int stopPc){
+    // Executes one instruction at a time on pc, reg and dataMem without touching the
+    // pipeline latches. Stops before the instruction at stopPc, after maxInstrs instructions,
+    // before a halt so the pipeline still retires it, or at a pc outside memory so the
+    // pipeline reports it. Returns the number executed.
+    stateType* state = &sim->state;
+    long long executed = 0;
+    int pc = state->pc;
+    int* reg = state->reg;
+
+    while (executed != maxInstrs && pc != stopPc && 0 <= pc && pc < NUMMEMORY && fetchDecoded(state, pc)->opcode != HALT) {
+        const decodedType* instr = fetchDecoded(state, pc);
+
+        switch(instr->opcode){
+            case ADD:
+            reg[instr->destReg] = reg[instr->regA] + reg[instr->regB];
+            break;
+            case NOR:
+            reg[instr->destReg] = ~(reg[instr->regA] | reg[instr->regB]);
+            break;
+            case LW:
+            reg[instr->destReg] = state->dataMem[reg[instr->regA] + instr->offset];
+            break;
+            case SW:
+            storeWord(state, reg[instr->regA] + instr->offset, reg[instr->regB]);
+            break;
+            case BEQ:
+            if(reg[instr->regA] == reg[instr->regB]){
+                pc += instr->offset;
+            }
+            break;
+        }
+
+        pc++;
+        executed++;
+    }
+
+    state->pc = pc;
+    sim->newState = *state;
+    return executed;
+}
+
+/*
+ * Threaded code is built a block at a time as execution first reaches it, and kept with
+ * the context: the next run revalidates it page by page against instrMem, so running the
+ * same image again only retranslates pages whose words changed.
+ */
+
+#define THREADEDMAXBLOCK 256 // instructions translated at once
+
+typedef struct threadedEntryStruct {
+    int handler; // handler address minus op_translate's, so a zeroed entry is untranslated
+    int regA;
+    int regB;
+    int destReg;
+    int offset;
+} threadedEntryType;
+
+typedef struct threadedStruct {
+    threadedEntryType code[NUMMEMORY + 1]; // the last entry catches a pc running off the end, and is never translated
+    int source[NUMMEMORY]; // instrMem as it was when each translated page was first translated
+    pageMaskType translated; // pages of code holding translations
+} threadedType;
+
+// Throws away the translations of every page whose instrMem words changed since it was translated
+static void revalidateThreaded(threadedType* threaded, const int* instrMem){
+    for (int page = 0; page < NUMPAGES; page++) {
+        int start = page << PAGESHIFT;
+        if (!(threaded->translated >> page & 1)
+            || !memcmp(threaded->source + start, instrMem + start, PAGEWORDS * sizeof(int))) continue;
+
+        memset(threaded->code + start, 0, PAGEWORDS * sizeof(threadedEntryType));
+        threaded->translated &= ~(1ULL << page);
+    }
+}
+
+static long long runThreaded(simulatorType* sim){
+    // Direct-threaded interpreter: each address is translated once into a handler, and each
+    // handler jumps straight to the next one instead of going back through a switch.
+    // lw+beq and add+beq pairs (the usual loop tails) get fused handlers.
+#define HANDLER(label) (&&label - &&op_translate)
+    static const int handlers[] = {
+        [ADD] = HANDLER(op_add), [NOR] = HANDLER(op_nor), [LW] = HANDLER(op_lw), [SW] = HANDLER(op_sw),
+        [BEQ] = HANDLER(op_beq), [JALR] = HANDLER(op_noop), [HALT] = HANDLER(op_halt), [NOOP] = HANDLER(op_noop)
+    };
+    stateType* state = &sim->state;
+
+    if (sim->threaded == NULL) {
+        // Reserved, not committed, like the context's memory
+        sim->threaded = mmap(NULL, sizeof(threadedType), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (sim->threaded == MAP_FAILED) {
+            sim->threaded = NULL;
+            snprintf(sim->error, MAXERRORLENGTH, "error: out of memory for threaded code\n");
+            return -1;
+        }
+    }
+    threadedType* threaded = sim->threaded;
+    threadedEntryType* code = threaded->code;
+    revalidateThreaded(threaded, state->instrMem);
+
+    int pc = state->pc;
+    int* reg = state->reg;
+    int* mem = state->dataMem;
+    long long executed = 0;
+    const threadedEntryType* instr;
+    const threadedEntryType* branch;
+
+#define DISPATCH(count) do { executed += (count); instr = code + pc; goto *(&&op_translate + instr->handler); } while (0)
+
+    if ((unsigned)pc > NUMMEMORY) goto op_outside;
+    DISPATCH(0);
+
+op_translate:
+    if (pc == NUMMEMORY) goto op_outside;
+
+    // Translate from pc up to and including the first beq or halt
+    for (int at = pc; at < NUMMEMORY && at - pc < THREADEDMAXBLOCK; at++) {
+        decodedType decoded;
+        decodeInstruction(state->instrMem[at], &decoded);
+        int opc = decoded.opcode;
+
+        code[at] = (threadedEntryType){ (ADD <= opc && opc <= NOOP) ? handlers[opc] : HANDLER(op_noop), // the pipeline ignores unknown opcodes too
+            decoded.regA, decoded.regB, decoded.destReg, decoded.offset };
+        if (!(threaded->translated >> (at >> PAGESHIFT) & 1)) {
+            int start = at & ~(PAGEWORDS - 1);
+            memcpy(threaded->source + start, state->instrMem + start, PAGEWORDS * sizeof(int));
+            markWritten(&threaded->translated, at);
+        }
+
+        // Fused pairs stay inside a page, so revalidating a page can't leave a stale one behind
+        if ((at + 1) & (PAGEWORDS - 1) && at + 1 - pc < THREADEDMAXBLOCK && opcode(state->instrMem[at + 1]) == BEQ) {
+            if (opc == LW) code[at].handler = HANDLER(op_lw_beq);
+            if (opc == ADD) code[at].handler = HANDLER(op_add_beq);
+        }
+        if (opc == BEQ || opc == HALT) break;
+    }
+    DISPATCH(0);
+
+op_add:
+    reg[instr->destReg] = reg[instr->regA] + reg[instr->regB];
+    pc++;
+    DISPATCH(1);
+op_nor:
+    reg[instr->destReg] = ~(reg[instr->regA] | reg[instr->regB]);
+    pc++;
+    DISPATCH(1);
+op_lw:
+    reg[instr->destReg] = mem[reg[instr->regA] + instr->offset];
+    pc++;
+    DISPATCH(1);
+op_sw:
+    storeWord(state, reg[instr->regA] + instr->offset, reg[instr->regB]);
+    pc++;
+    DISPATCH(1);
+op_beq:
+    pc += (reg[instr->regA] == reg[instr->regB]) ? instr->offset + 1 : 1;
+    if ((unsigned)pc > NUMMEMORY) goto op_outside;
+    DISPATCH(1);
+op_noop:
+    pc++;
+    DISPATCH(1);
+op_lw_beq:
+    reg[instr->destReg] = mem[reg[instr->regA] + instr->offset];
+    branch = instr + 1;
+    pc += (reg[branch->regA] == reg[branch->regB]) ? branch->offset + 2 : 2;
+    if ((unsigned)pc > NUMMEMORY) goto op_outside;
+    DISPATCH(2);
+op_add_beq:
+    reg[instr->destReg] = reg[instr->regA] + reg[instr->regB];
+    branch = instr + 1;
+    pc += (reg[branch->regA] == reg[branch->regB]) ? branch->offset + 2 : 2;
+    if ((unsigned)pc > NUMMEMORY) goto op_outside;
+    DISPATCH(2);
+op_halt:
+#undef DISPATCH
+#undef HANDLER
+    state->pc = pc + 1;
+    return executed + 1;
+op_outside:
+    // NUMMEMORY itself is left to op_translate, which lands here too
+    state->pc = pc;
+    snprintf(sim->error, MAXERRORLENGTH, "error: pc %d is outside memory\n", pc);
+    return -1;
+}
+
+static void threadedDestroy(threadedType* threaded){
+    if (threaded != NULL) munmap(threaded, sizeof(threadedType));
+}
+
+#if defined(__x86_64__)
+
+/*
+ * Basic-block translator to x86-64. Blocks run from their start address up to and
+ * including a beq, or up to (not including) a halt. The generated code keeps reg in
+ * rbx, dataMem in r12, the instruction counter's address in r13 and the dataMem page
+ * mask's address in r14 (every sw sets its page's bit), and every block
+ * exit is a patchable jmp so blocks chain directly once their target is translated.
+ * instrMem is never written in this machine (sw only reaches dataMem), so translations
+ * never go stale during a run. They are kept with the context, and the next run throws
+ * them all away only if a page they were made from has changed, so running the same
+ * image again reuses them.
+ */
+
+#define JITCACHESIZE (16 << 20) // bytes of executable code cache
+#define JITMAXBLOCK 256 // instructions per block
+#define JITMAXBLOCKBYTES (JITMAXBLOCK * 48 + 64) // worst case bytes emitted for one block
+#define JITMAXEXITS (JITCACHESIZE / 15) // each exit emits 15 bytes, so the cache fills up first
+
+typedef int (*jitEntryType)(int* reg, int* dataMem, long long* executed, const unsigned char* block, pageMaskType* dataPages);
+
+typedef struct jitExitStruct {
+    unsigned char* jump; // the exit's jmp rel32, patched to chain to the target block
+    int target;
+    int next; // 1 + the next unchained exit with the same target, 0 at the end
+} jitExitType;
+
+// Reserved with mmap and only committed where it is written, so the tables below start
+// zeroed for free and a reset only clears the pages that were used
+typedef struct jitStruct {
+    unsigned char* cache;
+    unsigned char* end; // next free byte in cache
+    unsigned char* exitStub; // restores callee-saved registers and returns eax as the next pc
+    jitEntryType enter;
+    unsigned char* blocks[NUMMEMORY]; // translated block for each start address, NULL if none
+    int pending[NUMMEMORY]; // 1 + the head of the unchained exits targeting each address, 0 if none
+    pageMaskType used; // pages of blocks and pending with entries set
+    int source[NUMMEMORY]; // instrMem as it was when each page in <translated> was first read
+    pageMaskType translated;
+    jitExitType* exits;
+    int numExits;
+} jitType;
+
+static inline void emitByte(jitType* jit, unsigned char byte) {
+    *jit->end++ = byte;
+}
+
+static inline void emitInt(jitType* jit, int value) {
+    memcpy(jit->end, &value, sizeof(value));
+    jit->end += sizeof(value);
+}
+
+// mov/op between a host register and reg[lcReg]: <op> r32, [rbx + 4 * lcReg]
+static inline void emitRegAccess(jitType* jit, unsigned char op, int hostReg, int lcReg) {
+    emitByte(jit, op);
+    emitByte(jit, 0x80 | (hostReg << 3) | 3); // mod = 10 (disp32), rm = rbx
+    emitInt(jit, lcReg * (int)sizeof(int));
+}
+
+#define HOST_EAX 0
+#define HOST_ECX 1
+
+#define X86_LOAD 0x8B // mov r32, r/m32
+#define X86_STORE 0x89 // mov r/m32, r32
+
+// Computes the word address reg[regA] + offset into rax
+static inline void emitAddress(jitType* jit, const decodedType* instr) {
+    emitRegAccess(jit, X86_LOAD, HOST_EAX, instr->regA);
+    emitByte(jit, 0x05); emitInt(jit, instr->offset); // add eax, imm32
+    emitByte(jit, 0x48); emitByte(jit, 0x63); emitByte(jit, 0xC0); // movsxd rax, eax
+}
+
+static inline void patchJump(unsigned char* jump, const unsigned char* target) {
+    int rel = (int)(target - (jump + 5));
+    memcpy(jump + 1, &rel, sizeof(rel));
+}
+
+// Emits a block exit to <target>: a jmp that initially falls through to "mov eax, target; jmp exitStub"
+static void emitExit(jitType* jit, int target) {
+    jitExitType* exitEntry = jit->exits + jit->numExits++;
+    exitEntry->jump = jit->end;
+    exitEntry->target = target;
+    exitEntry->next = 0;
+
+    emitByte(jit, 0xE9); emitInt(jit, 0); // jmp rel32 to the next instruction
+    emitByte(jit, 0xB8); emitInt(jit, target); // mov eax, imm32
+    emitByte(jit, 0xE9); emitInt(jit, 0);
+    patchJump(jit->end - 5, jit->exitStub);
+}
+
+static void jitReset(jitType* jit) {
+    // Throw away every translation, keeping the entry trampoline and exit stub at the start
+    clearPages(jit->blocks, sizeof(jit->blocks[0]), jit->used);
+    clearPages(jit->pending, sizeof(jit->pending[0]), jit->used);
+    jit->used = 0;
+    jit->translated = 0;
+    jit->numExits = 0;
+    jit->end = jit->exitStub + 8;
+}
+
+// Records that a translation depends on the word at <pc>
+static void jitReads(jitType* jit, const int* instrMem, int pc) {
+    if (jit->translated >> (pc >> PAGESHIFT) & 1) return;
+    int start = pc & ~(PAGEWORDS - 1);
+    memcpy(jit->source + start, instrMem + start, PAGEWORDS * sizeof(int));
+    markWritten(&jit->translated, pc);
+}
+
+static int jitInit(jitType* jit) {
+    jit->cache = mmap(NULL, JITCACHESIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->cache == MAP_FAILED) {
+        return -1;
+    }
+    jit->exits = malloc(JITMAXEXITS * sizeof(jitExitType));
+    if (jit->exits == NULL) {
+        munmap(jit->cache, JITCACHESIZE);
+        return -1;
+    }
+    jit->end = jit->cache;
+
+    // Entry trampoline: save rbx/r12/r13/r14, load them from the arguments and jump to the block
+    jit->enter = (jitEntryType)jit->end;
+    emitByte(jit, 0x53); // push rbx
+    emitByte(jit, 0x41); emitByte(jit, 0x54); // push r12
+    emitByte(jit, 0x41); emitByte(jit, 0x55); // push r13
+    emitByte(jit, 0x41); emitByte(jit, 0x56); // push r14
+    emitByte(jit, 0x48); emitByte(jit, 0x89); emitByte(jit, 0xFB); // mov rbx, rdi
+    emitByte(jit, 0x49); emitByte(jit, 0x89); emitByte(jit, 0xF4); // mov r12, rsi
+    emitByte(jit, 0x49); emitByte(jit, 0x89); emitByte(jit, 0xD5); // mov r13, rdx
+    emitByte(jit, 0x4D); emitByte(jit, 0x89); emitByte(jit, 0xC6); // mov r14, r8
+    emitByte(jit, 0xFF); emitByte(jit, 0xE1); // jmp rcx
+
+    jit->exitStub = jit->end;
+    emitByte(jit, 0x41); emitByte(jit, 0x5E); // pop r14
+    emitByte(jit, 0x41); emitByte(jit, 0x5D); // pop r13
+    emitByte(jit, 0x41); emitByte(jit, 0x5C); // pop r12
+    emitByte(jit, 0x5B); // pop rbx
+    emitByte(jit, 0xC3); // ret
+
+    jitReset(jit);
+    return 0;
+}
+
+static unsigned char* translateBlock(jitType* jit, stateType* state, int startPc) {
+    if (jit->end + JITMAXBLOCKBYTES > jit->cache + JITCACHESIZE) {
+        jitReset(jit);
+    }
+
+    unsigned char* block = jit->end;
+    int firstExit = jit->numExits;
+    int pc = startPc;
+
+    // add qword [r13], <instructions in block>, patched once the block length is known
+    emitByte(jit, 0x49); emitByte(jit, 0x81); emitByte(jit, 0x45); emitByte(jit, 0x00);
+    unsigned char* countImm = jit->end;
+    emitInt(jit, 0);
+
+    while (pc < NUMMEMORY && pc - startPc < JITMAXBLOCK) {
+        const decodedType* instr = fetchDecoded(state, pc);
+        jitReads(jit, state->instrMem, pc);
+
+        if (instr->opcode == HALT) break; // the dispatcher retires the halt itself
+
+        pc++;
+        switch (instr->opcode) {
+            case ADD:
+            case NOR:
+            emitRegAccess(jit, X86_LOAD, HOST_EAX, instr->regA);
+            emitRegAccess(jit, X86_LOAD, HOST_ECX, instr->regB);
+            if (instr->opcode == ADD) {
+                emitByte(jit, 0x01); emitByte(jit, 0xC8); // add eax, ecx
+            } else {
+                emitByte(jit, 0x09); emitByte(jit, 0xC8); // or eax, ecx
+                emitByte(jit, 0xF7); emitByte(jit, 0xD0); // not eax
+            }
+            emitRegAccess(jit, X86_STORE, HOST_EAX, instr->destReg);
+            break;
+            case LW:
+            emitAddress(jit, instr);
+            emitByte(jit, 0x41); emitByte(jit, 0x8B); emitByte(jit, 0x0C); emitByte(jit, 0x84); // mov ecx, [r12 + rax * 4]
+            emitRegAccess(jit, X86_STORE, HOST_ECX, instr->destReg);
+            break;
+            case SW:
+            emitAddress(jit, instr);
+            emitRegAccess(jit, X86_LOAD, HOST_ECX, instr->regB);
+            emitByte(jit, 0x41); emitByte(jit, 0x89); emitByte(jit, 0x0C); emitByte(jit, 0x84); // mov [r12 + rax * 4], ecx
+            emitByte(jit, 0x89); emitByte(jit, 0xC1); // mov ecx, eax
+            emitByte(jit, 0xC1); emitByte(jit, 0xE9); emitByte(jit, PAGESHIFT); // shr ecx, PAGESHIFT
+            emitByte(jit, 0xBA); emitInt(jit, 1); // mov edx, 1
+            emitByte(jit, 0x48); emitByte(jit, 0xD3); emitByte(jit, 0xE2); // shl rdx, cl
+            emitByte(jit, 0x49); emitByte(jit, 0x09); emitByte(jit, 0x16); // or [r14], rdx
+            break;
+            case BEQ:
+            {
+                emitRegAccess(jit, X86_LOAD, HOST_EAX, instr->regA);
+                emitRegAccess(jit, X86_LOAD, HOST_ECX, instr->regB);
+                emitByte(jit, 0x39); emitByte(jit, 0xC8); // cmp eax, ecx
+                emitByte(jit, 0x0F); emitByte(jit, 0x84); // je rel32 to the taken exit
+                unsigned char* taken = jit->end;
+                emitInt(jit, 0);
+                emitExit(jit, pc);
+                int rel = (int)(jit->end - (taken + 4));
+                memcpy(taken, &rel, sizeof(rel));
+                emitExit(jit, pc + instr->offset);
+                goto done;
+            }
+            default:
+            break; // noop, and jalr/unknown opcodes which the pipeline also ignores
+        }
+    }
+    emitExit(jit, pc);
+
+done:
+    {
+        int length = pc - startPc;
+        memcpy(countImm, &length, sizeof(length));
+    }
+    jit->blocks[startPc] = block;
+    markWritten(&jit->used, startPc);
+
+    // Chain this block's exits to blocks that already exist, and queue the rest
+    for (int e = firstExit; e < jit->numExits; e++) {
+        int target = jit->exits[e].target;
+        if (0 <= target && target < NUMMEMORY && jit->blocks[target] != NULL) {
+            patchJump(jit->exits[e].jump, jit->blocks[target]);
+        } else if (0 <= target && target < NUMMEMORY) {
+            jit->exits[e].next = jit->pending[target];
+            jit->pending[target] = e + 1;
+            markWritten(&jit->used, target);
+        }
+    }
+
+    // Then chain every earlier exit that was waiting for this address
+    for (int e = jit->pending[startPc]; e != 0; e = jit->exits[e - 1].next) {
+        patchJump(jit->exits[e - 1].jump, block);
+    }
+    jit->pending[startPc] = 0;
+
+    return block;
+}
+
+static long long runJit(simulatorType* sim){
+    stateType* state = &sim->state;
+    long long executed = 0;
+    int pc = state->pc;
+
+    if (sim->jit == NULL) {
+        jitType* jit = mmap(NULL, sizeof(jitType), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (jit == MAP_FAILED || jitInit(jit)) {
+            if (jit != MAP_FAILED) munmap(jit, sizeof(jitType));
+            snprintf(sim->error, MAXERRORLENGTH, "error: can't set up the jit code cache\n");
+            return -1;
+        }
+        sim->jit = jit;
+    }
+    jitType* jit = sim->jit;
+
+    // Blocks can chain into each other from any page, so one changed page drops them all
+    for (int page = 0; page < NUMPAGES; page++) {
+        int start = page << PAGESHIFT;
+        if ((jit->translated >> page & 1)
+            && memcmp(jit->source + start, state->instrMem + start, PAGEWORDS * sizeof(int))) {
+            jitReset(jit);
+            break;
+        }
+    }
+
+    while (pc < 0 || pc >= NUMMEMORY || fetchDecoded(state, pc)->opcode != HALT) {
+        if (pc < 0 || pc >= NUMMEMORY) {
+            // Block exits leave memory only through the dispatcher, since they never chain there
+            state->pc = pc;
+            snprintf(sim->error, MAXERRORLENGTH, "error: pc %d is outside memory\n", pc);
+            return -1;
+        }
+        const unsigned char* block = jit->blocks[pc] ? jit->blocks[pc] : translateBlock(jit, state, pc);
+        pc = jit->enter(state->reg, state->dataMem, &executed, block, &state->written->data);
+    }
+
+    state->pc = pc + 1;
+    return executed + 1;
+}
+
+static void jitDestroy(jitType* jit){
+    munmap(jit->cache, JITCACHESIZE);
+    free(jit->exits);
+    munmap(jit, sizeof(jitType));
+}
+
+#else
+
+typedef struct jitStruct {
+    int unused;
+} jitType;
+
+static void jitDestroy(jitType* jit){
+    free(jit);
+}
+
+static long long runJit(simulatorType* sim){
+    // No code generator for this host, so fall back to the interpreter
+    return runThreaded(sim);
+}
+
+#endif
+
+int parseEngine(char* name){
+    // Returns -1 for an unknown engine so main can print the usage message
+    if(!strcmp(name, "pipeline")) return ENGINE_PIPELINE;
+    if(!strcmp(name, "threaded")) return ENGINE_THREADED;
+    if(!strcmp(name, "jit")) return ENGINE_JIT;
+    if(!strcmp(name, "dual")) return ENGINE_DUAL;
+    if(!strcmp(name, "ooo")) return ENGINE_OOO;
+    if(!strcmp(name, "simd")) return ENGINE_SIMD;
+    if(!strcmp(name, "deep")) return ENGINE_DEEP;
+    return -1;
+}
+
+int parseResolveStage(char* name){
+    // Returns -1 for an unknown stage so main can print the usage message
+    for (int stage = RESOLVE_MEM; stage <= RESOLVE_ID; stage++) {
+        if (!strcmp(name, resolve_to_str_map[stage])) return stage;
+    }
+    return -1;
+}
+
+int parseTraceLevel(char* level){
+    // Returns -1 for an unknown level so main can print the usage message
+    if(!strcmp(level, "none")) return TRACE_NONE;
+    if(!strcmp(level, "final")) return TRACE_FINAL;
+    if(!strcmp(level, "summary")) return TRACE_SUMMARY;
+    if(!strcmp(level, "full")) return TRACE_FULL;
+    return -1;
+}
+
+void printSummary(stateType* state){
+    // One line per cycle: the pc and the instruction held in each pipeline register
+    printf("cycle %d pc %d |", state->cycles, state->pc);
+    printf(" IF/ID "); printInstruction(state->IFID.instr);
+    printf(" | ID/EX "); printInstruction(state->IDEX.instr);
+    printf(" | EX/MEM "); printInstruction(state->EXMEM.instr);
+    printf(" | MEM/WB "); printInstruction(state->MEMWB.instr);
+    printf(" | WB/END "); printInstruction(state->WBEND.instr);
+    printf("\n");
+}
+
+void decodeInstruction(int instr, decodedType* decoded){
+    int opc = opcode(instr);
+
+    decoded->valid = 1;
+    decoded->opcode = opc;
+    decoded->regA = field0(instr);
+    decoded->regB = field1(instr);
+    decoded->offset = convertNum(field2(instr));
+    decoded->readsRegA = (opc == ADD || opc == NOR || opc == LW || opc == SW || opc == BEQ);
+    decoded->readsRegB = (opc == ADD || opc == NOR || opc == SW || opc == BEQ);
+    decoded->writesReg = (opc == ADD || opc == NOR || opc == LW);
+    decoded->forwardsInto = (opc != JALR && opc != HALT && opc != NOOP);
+    decoded->destReg = opc == LW ? field1(instr) : field2(instr);
+}
+
+int processField(const decodedType* instr, int* valA, int* valB, const decodedType* target, int writeData){
+    // Returns which operands were replaced: bit 0 for valA, bit 1 for valB
+    if(!target->writesReg) return 0;
+
+    int forwarded = 0;
+
+    // Check if current instruction field0 or field1 rely on the target's destination
+    if(instr->regA == target->destReg){
+        *valA = writeData;
+        forwarded |= instr->readsRegA;
+    }
+    if(instr->regB == target->destReg){
+        *valB = writeData;
+        forwarded |= instr->readsRegB << 1;
+    }
+    return forwarded;
+}
+
+void dataHazard(int* valA, int* valB, stateType* state, long long forwards[NUMFORWARDSOURCES]){
+    // Will process data hazard and forwarding (checks WBEND, MEMWB, then EXMEM writeDatas and formatting properly based on the current instruction)
+
+    const decodedType* instr = state->IDEX.decoded; // Since we will be checking in the IDEX stage
+
+    if(!instr->forwardsInto) return; // If we don't care about data forwarding
+
+    // Later latches override earlier ones, so each operand is credited to the last one that matched
+    int sourceA = -1, sourceB = -1, forwarded;
+
+    forwarded = processField(instr, valA, valB, state->WBEND.decoded, state->WBEND.writeData);
+    if (forwarded & 1) sourceA = FORWARD_WBEND;
+    if (forwarded & 2) sourceB = FORWARD_WBEND;
+    forwarded = processField(instr, valA, valB, state->MEMWB.decoded, state->MEMWB.writeData);
+    if (forwarded & 1) sourceA = FORWARD_MEMWB;
+    if (forwarded & 2) sourceB = FORWARD_MEMWB;
+    forwarded = processField(instr, valA, valB, state->EXMEM.decoded, state->EXMEM.aluResult);
+    if (forwarded & 1) sourceA = FORWARD_EXMEM;
+    if (forwarded & 2) sourceB = FORWARD_EXMEM;
+
+    if (sourceA >= 0) forwards[sourceA]++;
+    if (sourceB >= 0) forwards[sourceB]++;
+}
+
+/*
+* DO NOT MODIFY ANY OF THE CODE BELOW.
+*/
+
+void printInstruction(int instr) {
+    const char* instr_opcode_str;
+    int instr_opcode = opcode(instr);
+    if(ADD <= instr_opcode && instr_opcode <= NOOP) {
+        instr_opcode_str = opcode_to_str_map[instr_opcode];
+    }
+
+    switch (instr_opcode) {
+        case ADD:
+        case NOR:
+        case LW:
+        case SW:
+        case BEQ:
+            printf("%s %d %d %d", instr_opcode_str, field0(instr), field1(instr), convertNum(field2(instr)));
+            break;
+        case JALR:
+            printf("%s %d %d", instr_opcode_str, field0(instr), field1(instr));
+            break;
+        case HALT:
+        case NOOP:
+            printf("%s", instr_opcode_str);
+            break;
+        default:
+            printf(".fill %d", instr);
+            return;
+    }
+}
+
+void printState(stateType *statePtr) {
+    printf("\n@@@\n");
+    printf("state before cycle %d starts:\n", statePtr->cycles);
+    printf("\tpc = %d\n", statePtr->pc);
+
+    printf("\tdata memory:\n");
+    for (int i=0; i<statePtr->numMemory; ++i) {
+        printf("\t\tdataMem[ %d ] = 0x%08X\n", i, statePtr->dataMem[i]);
+    }
+    printf("\tregisters:\n");
+    for (int i=0; i<NUMREGS; ++i) {
+        printf("\t\treg[ %d ] = %d\n", i, statePtr->reg[i]);
+    }
+
+    // IF/ID
+    printf("\tIF/ID pipeline register:\n");
+    printf("\t\tinstruction = 0x%08X ( ", statePtr->IFID.instr);
+    printInstruction(statePtr->IFID.instr);
+    printf(" )\n");
+    printf("\t\tpcPlus1 = %d", statePtr->IFID.pcPlus1);
+    if(opcode(statePtr->IFID.instr) == NOOP){
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+    
+    // ID/EX
+    int idexOp = opcode(statePtr->IDEX.instr);
+    printf("\tID/EX pipeline register:\n");
+    printf("\t\tinstruction = 0x%08X ( ", statePtr->IDEX.instr);
+    printInstruction(statePtr->IDEX.instr);
+    printf(" )\n");
+    printf("\t\tpcPlus1 = %d", statePtr->IDEX.pcPlus1);
+    if(idexOp == NOOP){
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+    printf("\t\treadRegA = %d", statePtr->IDEX.valA);
+    if (idexOp >= HALT || idexOp < 0) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+    printf("\t\treadRegB = %d", statePtr->IDEX.valB);
+    if(idexOp == LW || idexOp > BEQ || idexOp < 0) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+    printf("\t\toffset = %d", statePtr->IDEX.offset);
+    if (idexOp != LW && idexOp != SW && idexOp != BEQ) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+
+    // EX/MEM
+    int exmemOp = opcode(statePtr->EXMEM.instr);
+    printf("\tEX/MEM pipeline register:\n");
+    printf("\t\tinstruction = 0x%08X ( ", statePtr->EXMEM.instr);
+    printInstruction(statePtr->EXMEM.instr);
+    printf(" )\n");
+    printf("\t\tbranchTarget %d", statePtr->EXMEM.branchTarget);
+    if (exmemOp != BEQ) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+    printf("\t\teq ? %s", (statePtr->EXMEM.eq ? "True" : "False"));
+    if (exmemOp != BEQ) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+    printf("\t\taluResult = %d", statePtr->EXMEM.aluResult);
+    if (exmemOp > SW || exmemOp < 0) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+    printf("\t\treadRegB = %d", statePtr->EXMEM.valB);
+    if (exmemOp != SW) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+
+    // MEM/WB
+	int memwbOp = opcode(statePtr->MEMWB.instr);
+    printf("\tMEM/WB pipeline register:\n");
+    printf("\t\tinstruction = 0x%08X ( ", statePtr->MEMWB.instr);
+    printInstruction(statePtr->MEMWB.instr);
+    printf(" )\n");
+    printf("\t\twriteData = %d", statePtr->MEMWB.writeData);
+    if (memwbOp >= SW || memwbOp < 0) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");     
+
+    // WB/END
+	int wbendOp = opcode(statePtr->WBEND.instr);
+    printf("\tWB/END pipeline register:\n");
+    printf("\t\tinstruction = 0x%08X ( ", statePtr->WBEND.instr);
+    printInstruction(statePtr->WBEND.instr);
+    printf(" )\n");
+    printf("\t\twriteData = %d", statePtr->WBEND.writeData);
+    if (wbendOp >= SW || wbendOp < 0) {
+        printf(" (Don't Care)");
+    }
+    printf("\n");
+
+    printf("end state\n");
+    fflush(stdout);
+}
+
+// File
+#define MAXLINELENGTH 1000 // MAXLINELENGTH is the max number of characters we read
+
+static void unmapImage(simulatorType* sim){
+    for (int mapping = 0; mapping < 2; mapping++) {
+        if (sim->imageMappings[mapping] != NULL) {
+            munmap(sim->imageMappings[mapping], sim->imageMappingLength);
+            sim->imageMappings[mapping] = NULL;
+        }
+    }
+}
+
+static int mapImage(simulatorType* sim, int fd, const char* filename) {
+    // Maps a linker -b image twice: read-only for instrMem and copy-on-write for dataMem.
+    // Each mapping reserves the whole address space first, so words past the image read as 0.
+    stateType* state = &sim->state;
+    imageHeaderType header;
+    struct stat info;
+
+    if (fstat(fd, &info) || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+        || header.version != IMAGEVERSION
+        || (unsigned long long)header.textSize + header.dataSize > NUMMEMORY
+        || (unsigned long long)info.st_size != sizeof(header) + ((unsigned long long)header.textSize + header.dataSize) * sizeof(int)) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: %s is not a valid version %d image\n", filename, IMAGEVERSION);
+        return -1;
+    }
+    if (header.entry >= NUMMEMORY) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: entry point %u of %s is outside memory\n", header.entry, filename);
+        return -1;
+    }
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    sim->imageMappingLength = (NUMMEMORY * sizeof(int) + sizeof(header) + pageSize - 1) / pageSize * pageSize;
+
+    for (int mapping = 0; mapping < 2; mapping++) {
+        int protection = mapping == 0 ? PROT_READ : PROT_READ | PROT_WRITE;
+        void* reserved = mmap(NULL, sim->imageMappingLength, protection, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved == MAP_FAILED) {
+            unmapImage(sim);
+            snprintf(sim->error, MAXERRORLENGTH, "error: can't map %s\n", filename);
+            return -1;
+        }
+        sim->imageMappings[mapping] = reserved;
+        if (mmap(reserved, info.st_size, protection, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            unmapImage(sim);
+            snprintf(sim->error, MAXERRORLENGTH, "error: can't map %s\n", filename);
+            return -1;
+        }
+    }
+
+    state->instrMem = (int*)((char*)sim->imageMappings[0] + sizeof(header));
+    state->dataMem = (int*)((char*)sim->imageMappings[1] + sizeof(header));
+    state->numMemory = header.textSize + header.dataSize;
+    state->pc = header.entry;
+    markRange(&state->written->instr, 0, state->numMemory);
+    markRange(&state->written->data, 0, state->numMemory);
+
+    if (imageChecksum(state->instrMem, state->numMemory) != header.checksum) {
+        unmapImage(sim);
+        snprintf(sim->error, MAXERRORLENGTH, "error: checksum mismatch in %s\n", filename);
+        return -1;
+    }
+
+    // Entries are left invalid and decoded on first fetch
+    if (sim->traceLevel == TRACE_FULL) {
+        printf("instruction memory:\n");
+        for (int address = 0; address < state->numMemory; address++) {
+            printf("\tinstrMem[ %d ] = 0x%08X ( ", address, state->instrMem[address]);
+            printInstruction(state->instrMem[address]);
+            printf(" )\n");
+        }
+    }
+    return 0;
+}
+
+static int readMachineCode(simulatorType* sim, const char* filename) {
+    stateType* state = &sim->state;
+    char line[MAXLINELENGTH];
+    FILE *filePtr = fopen(filename, "r");
+    if (filePtr == NULL) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: can't open file %s", filename);
+        return -1;
+    }
+
+    char magic[sizeof(IMAGEMAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), filePtr) == sizeof(magic) && !memcmp(magic, IMAGEMAGIC, sizeof(magic))) {
+        int result = mapImage(sim, fileno(filePtr), filename);
+        fclose(filePtr);
+        return result;
+    }
+    rewind(filePtr);
+
+    if (sim->traceLevel == TRACE_FULL) printf("instruction memory:\n");
+    for (state->numMemory = 0; fgets(line, MAXLINELENGTH, filePtr) != NULL; ++state->numMemory) {
+        if (sscanf(line, "%x", state->instrMem+state->numMemory) != 1) {
+            snprintf(sim->error, MAXERRORLENGTH, "error in reading address %d\n", state->numMemory);
+            fclose(filePtr);
+            return -1;
+        }
+        state->dataMem[state->numMemory] = state->instrMem[state->numMemory];
+        decodeInstruction(state->instrMem[state->numMemory], state->decoded + state->numMemory);
+        markWritten(&state->written->instr, state->numMemory);
+        markWritten(&state->written->data, state->numMemory);
+        markWritten(&state->written->decoded, state->numMemory);
+        if (sim->traceLevel != TRACE_FULL) continue; // Skip echoing the program unless we want the full dump
+        printf("\tinstrMem[ %d ] = 0x%08X ( ", state->numMemory, 
+            state->instrMem[state->numMemory]);
+        printInstruction(state->instrMem[state->numMemory]);
+        printf(" )\n");
+    }
+    fclose(filePtr);
+    return 0;
+}
@@ -0,0 +1,456 @@
+#ifndef LC2KSIM_H
+#define LC2KSIM_H
+
+/*
+ * Reentrant LC2K simulation engine: the 5-stage pipeline and the functional
+ * engines, with all state kept in a simulatorType context so that many
+ * simulations can run in one process (and on several threads at once).
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "cache.h"
+
+// Machine Definitions
+#define NUMMEMORY 65536 // maximum number of data words in memory
+#define NUMREGS 8 // number of machine registers
+
+// Guest memory is tracked in pages so that resets and checkpoints only visit the
+// pages a program actually wrote; the rest were never touched and are still 0
+#define PAGESHIFT 10 // 1024 words, one 4 KB host page of ints
+#define PAGEWORDS (1 << PAGESHIFT)
+#define NUMPAGES (NUMMEMORY >> PAGESHIFT)
+
+#if NUMPAGES > 64
+#error "a pageMaskType has one bit per page"
+#endif
+
+#define ADD 0
+#define NOR 1
+#define LW 2
+#define SW 3
+#define BEQ 4
+#define JALR 5 // will not implemented for Project 3
+#define HALT 6
+#define NOOP 7
+
+extern const char* opcode_to_str_map[];
+
+#define NOOPINSTR (NOOP << 22)
+
+// Trace levels (how much the simulator prints while running)
+#define TRACE_NONE 0 // only the halt message and cycle count
+#define TRACE_FINAL 1 // the final state of the machine
+#define TRACE_SUMMARY 2 // one line per cycle plus the final state
+#define TRACE_FULL 3 // the full state before every cycle (default)
+
+// Execution engines
+#define ENGINE_PIPELINE 0 // cycle-accurate 5-stage pipeline (default)
+#define ENGINE_THREADED 1 // functional direct-threaded interpreter, no timing
+#define ENGINE_JIT 2 // functional x86-64 basic-block translator, no timing
+#define ENGINE_DUAL 3 // 2-wide in-order pipeline, cycle counts but no per-cycle trace
+#define ENGINE_OOO 4 // out-of-order core with a ROB, cycle counts but no per-cycle trace
+#define ENGINE_SIMD 5 // functional, contexts run in lock step in vector lanes (runLanes), no timing
+#define ENGINE_DEEP 6 // in-order pipeline with configurable stage counts, cycle counts but no per-cycle trace
+
+// Branch predictors used in the IF stage
+#define PREDICT_NONE 0 // always not taken (default)
+#define PREDICT_BACKWARD 1 // static: taken if the BTB target is backward
+#define PREDICT_BIMODAL 2 // 2-bit counters indexed by pc
+#define PREDICT_GSHARE 3 // 2-bit counters indexed by pc xor global history
+#define PREDICT_TOURNAMENT 4 // chooser between bimodal and gshare
+
+// Stage that resolves beq; earlier stages squash fewer slots but need the operands sooner
+#define RESOLVE_MEM 0 // compare in EX, redirect in MEM (default)
+#define RESOLVE_EX 1 // compare and redirect in EX
+#define RESOLVE_ID 2 // compare in ID with forwarding from EX/MEM and MEM/WB, stalling on younger producers
+
+extern const char* resolve_to_str_map[];
+
+#define PREDICTORSIZE 1024 // counters per table, a power of 2
+#define BTBSIZE 256 // direct-mapped BTB entries, a power of 2
+
+// Latches dataHazard forwards from, indexing countersType.forwards
+#define FORWARD_EXMEM 0
+#define FORWARD_MEMWB 1
+#define FORWARD_WBEND 2
+#define NUMFORWARDSOURCES 3
+
+#define MAXROBSIZE 512 // largest reorder buffer ENGINE_OOO accepts
+
+#define MAXSTAGES 8 // most IF, EX or MEM stages ENGINE_DEEP accepts
+
+#define MAXCORES 16 // pipelines a multi-core run can share one memory between
+
+// Contexts ENGINE_SIMD runs at once: one per 32-bit lane of the widest vectors the build targets
+#if defined(__AVX512F__)
+#define SIMDLANES 16
+#elif defined(__AVX2__)
+#define SIMDLANES 8
+#else
+#define SIMDLANES 4 // SSE2, which every x86-64 has
+#endif
+
+#define MAXERRORLENGTH 1100 // room for a file name in error messages
+
+// An instruction decoded once when it is first fetched, so the pipeline stages and
+// hazard logic don't re-extract fields from the raw word every cycle
+typedef struct decodedStruct {
+    int valid; // 0 until the entry has been decoded from instrMem
+    int opcode;
+    int regA; // field0
+    int regB; // field1
+    int destReg; // register written by add/nor/lw
+    int offset; // field2, sign extended
+    int readsRegA;
+    int readsRegB;
+    int writesReg;
+    int forwardsInto; // the pipeline's EX forwards into it: the original test, which also takes unknown opcodes
+} decodedType;
+
+typedef struct IFIDStruct {
+    int instr;
+	int pcPlus1;
+	const decodedType* decoded;
+	int predictedTaken; // the IF stage redirected fetch to the BTB target
+	int predictHistory; // global history the prediction was made with
+} IFIDType;
+
+typedef struct IDEXStruct {
+    int instr;
+	int pcPlus1;
+	int valA;
+	int valB;
+	int offset;
+	const decodedType* decoded;
+	int predictedTaken;
+	int predictHistory;
+} IDEXType;
+
+typedef struct EXMEMStruct {
+    int instr;
+	int branchTarget;
+    int eq;
+	int aluResult;
+	int valB;
+	const decodedType* decoded;
+	int predictedTaken;
+	int predictHistory;
+	int pcPlus1; // where fetch resumes if a predicted-taken beq falls through
+} EXMEMType;
+
+typedef struct MEMWBStruct {
+    int instr;
+	int writeData;
+	const decodedType* decoded;
+	int pcPlus1; // for the profiler
+} MEMWBType;
+
+typedef struct WBENDStruct {
+    int instr;
+	int writeData;
+	const decodedType* decoded;
+} WBENDType;
+
+typedef unsigned long long pageMaskType; // bit n set if page n has been written
+
+// Pages of each memory array written since the context was last reset
+typedef struct pageMapStruct {
+	pageMaskType instr;
+	pageMaskType data;
+	pageMaskType decoded;
+} pageMapType;
+
+// Architectural memory lives apart from the pipeline latches so that ending a
+// cycle only copies the latches, not 512 KB of memory. It is reserved with mmap,
+// so the host only allocates the pages that are written.
+typedef struct memoryStruct {
+	int instrMem[NUMMEMORY];
+	int dataMem[NUMMEMORY];
+	decodedType decoded[NUMMEMORY]; // Decoded copy of instrMem
+	pageMapType written;
+} memoryType;
+
+typedef struct stateStruct {
+    unsigned int numMemory;
+    unsigned int cycles; // number of cycles run so far
+	int pc;
+	int* instrMem; // Shared by state and newState
+	int* dataMem; // Shared by state and newState, written at the end of the cycle
+	decodedType* decoded; // Shared by state and newState
+	pageMapType* written; // Shared by state and newState
+	int reg[NUMREGS];
+	IFIDType IFID;
+	IDEXType IDEX;
+	EXMEMType EXMEM;
+	MEMWBType MEMWB;
+	WBENDType WBEND;
+} stateType;
+
+static inline int opcode(int instruction) {
+    return instruction>>22;
+}
+
+static inline int field0(int instruction) {
+    return (instruction>>19) & 0x7;
+}
+
+static inline int field1(int instruction) {
+    return (instruction>>16) & 0x7;
+}
+
+static inline int field2(int instruction) {
+    return instruction & 0xFFFF;
+}
+
+// convert a 16-bit number into a 32-bit Linux integer
+static inline int convertNum(int num) {
+    return num - ( (num & (1<<15)) ? 1<<16 : 0 );
+}
+
+// What squashed and empty latches point at
+extern const decodedType noopDecoded;
+
+// What the timing engines fetch from a pc outside memory. It flows down the pipeline like
+// a noop and is only an error if it reaches writeback, since a wrong path can run off the end.
+extern const decodedType outsideDecoded;
+
+void decodeInstruction(int instr, decodedType* decoded);
+
+static inline void markWritten(pageMaskType* pages, int address) {
+    *pages |= 1ULL << (address >> PAGESHIFT);
+}
+
+// Every sw goes through here so the page it lands in is known to be written
+static inline void storeWord(stateType* state, int address, int value) {
+    state->dataMem[address] = value;
+    markWritten(&state->written->data, address);
+}
+
+// Returns the decoded instruction at <pc>, decoding it first if its entry was invalidated
+static inline const decodedType* fetchDecoded(stateType* state, int pc) {
+    decodedType* entry = state->decoded + pc;
+    if (!entry->valid) {
+        decodeInstruction(state->instrMem[pc], entry);
+        markWritten(&state->written->decoded, pc);
+    }
+    return entry;
+}
+
+typedef struct btbEntryStruct {
+    int pc; // -1 if empty
+    int target;
+} btbEntryType;
+
+typedef struct predictorStruct {
+    int kind; // PREDICT_*
+    unsigned char bimodal[PREDICTORSIZE];
+    unsigned char gshare[PREDICTORSIZE];
+    unsigned char chooser[PREDICTORSIZE]; // >= 2 picks gshare
+    int history; // global history of resolved outcomes
+    btbEntryType btb[BTBSIZE];
+    long long branches;
+    long long mispredicts;
+    long long btbMisses; // resolved beqs that weren't in the BTB
+} predictorType;
+
+// Pipeline performance counters, reset on every load or restore
+typedef struct countersStruct {
+    long long retired; // instructions that reached WB, halt included
+    long long opcodeMix[NOOP + 1]; // retired instructions by opcode
+    long long loadUseStalls; // bubbles the ID stage inserted behind a lw
+    long long squashedSlots; // fetched slots thrown away by mispredicted beqs
+    long long branchStalls; // bubbles the ID stage inserted for a beq's operands (RESOLVE_ID)
+    long long dualIssues; // cycles ENGINE_DUAL issued two instructions
+    long long robFullStalls; // cycles ENGINE_OOO couldn't dispatch because the ROB was full
+    long long storeForwards; // ENGINE_OOO loads that took their data from an older store
+    long long aluUseStalls; // bubbles ENGINE_DEEP's ID inserted for an add/nor still in a deeper EX
+    long long forwards[NUMFORWARDSOURCES]; // EX operands taken from a latch instead of the register file
+} countersType;
+
+// Sizes and latencies of the out-of-order core
+typedef struct oooConfigStruct {
+    int robSize; // reorder buffer entries, at most MAXROBSIZE
+    int rsSize; // reservation stations: entries waiting to issue
+    int lsqSize; // lw/sw in flight
+    int width; // instructions dispatched, issued and committed per cycle
+    int aluLatency; // add, nor, and sw address and data
+    int loadLatency;
+    int branchLatency;
+} oooConfigType;
+
+// Stage counts of ENGINE_DEEP; ID and WB are always one stage each
+typedef struct depthConfigStruct {
+    int fetchStages;
+    int executeStages; // add/nor results can be forwarded once through the last one
+    int memoryStages; // lw data can be forwarded once through the last one
+} depthConfigType;
+
+// Cycles the profiler charges to one instruction address
+typedef struct profileEntryStruct {
+    long long retired; // times it reached WB, one cycle each
+    long long stalls; // bubbles ID inserted while it waited for an operand
+    long long squashes; // slots thrown away when it was a mispredicted beq
+    long long memStalls; // cycles the pipeline waited on a cache miss it caused
+} profileEntryType;
+
+// Geometry of a pipeline cache; blockSize 0 means no cache (every access hits)
+typedef struct cacheConfigStruct {
+    int blockSize; // words per block
+    int numSets;
+    int blocksPerSet;
+} cacheConfigType;
+
+// A simulation context. Tracing prints to stdout, so contexts running on
+// several threads at once should use TRACE_NONE.
+typedef struct simulatorStruct {
+    stateType state;
+    stateType newState;
+    memoryType* memory;
+    void* imageMappings[2]; // instrMem and dataMem of a mapped binary image, NULL otherwise
+    size_t imageMappingLength;
+    int traceLevel; // TRACE_* (default TRACE_FULL)
+    int engine; // ENGINE_* (default ENGINE_PIPELINE)
+    predictorType predictor; // set predictor.kind before loading
+    int resolveStage; // RESOLVE_* (default RESOLVE_MEM); a restored checkpoint sets its own
+    oooConfigType ooo; // ENGINE_OOO configuration
+    depthConfigType depth; // ENGINE_DEEP configuration
+    cacheConfigType icacheConfig; // set before loading; IF goes through the I-cache
+    cacheConfigType dcacheConfig; // and lw/sw in MEM through the D-cache
+    int memLatency; // cycles the pipeline stalls for each block filled or written back
+    cacheStruct* icache; // NULL without a cache
+    cacheStruct* dcache;
+    int memStall; // stall cycles still owed by the current cycle's misses
+    int memStallPc[2]; // who owes them: IF's fetch, then MEM's load or store,
+    int memStallOwed[2]; // charged to the profile a cycle at a time as the pipeline waits them out
+    long long memStallCycles; // total cycles spent stalled on memory
+    countersType counters;
+    int profiling; // set before loading to charge cycles to instruction addresses
+    profileEntryType* profile; // NUMMEMORY entries while profiling, NULL otherwise
+    FILE* sampleFile; // if set, the pipeline writes its counters there every sampleInterval cycles
+    int sampleInterval;
+    struct memTraceStruct* memTrace; // if set, the pipeline records every fetch, lw and sw there (memtrace.h)
+    int halted;
+    long long executed; // instructions retired by a functional engine
+    struct threadedStruct* threaded; // threaded code, built on first use
+    struct jitStruct* jit; // translator state, built on first use
+    struct simdStruct* simd; // lane memory of runLanes, built on first use
+    decodedType restored[5]; // what the latches of a restored checkpoint point at
+    char error[MAXERRORLENGTH]; // message for the last failed call
+} simulatorType;
+
+// Context lifetime. simulatorCreate returns NULL if it can't allocate.
+simulatorType* simulatorCreate(void);
+void simulatorDestroy(simulatorType* sim);
+
+// Resets the context and loads a machine-code file, either the text format or a binary
+// image from linker -b (which is mapped rather than parsed). Returns 0, or -1 with sim->error set.
+int simulatorLoad(simulatorType* sim, const char* fileName);
+
+// Runs functionally to the given instruction count or pc (-1 for no limit), leaving the
+// pipeline empty at that point. Returns the number of instructions executed.
+long long simulatorFastForward(simulatorType* sim, long long maxInstrs, int stopPc);
+
+// Runs one pipeline cycle. Returns 1 once the machine has halted, or -1 with sim->error set
+// if it has to run an instruction from outside memory.
+int simulatorStep(simulatorType* sim);
+
+// Runs to halt with the context's engine. Returns 0, or -1 with sim->error set (the pc
+// leaving memory is an error in every engine).
+int simulatorRun(simulatorType* sim);
+
+const stateType* simulatorState(const simulatorType* sim);
+
+// Writes the whole machine (latches, registers, nonzero words of the written pages,
+// cycle count) to a checkpoint file, or replaces the context's machine with one read back from it.
+// Both return 0, or -1 with sim->error set.
+int simulatorSave(simulatorType* sim, const char* fileName);
+int simulatorRestore(simulatorType* sim, const char* fileName);
+
+void printState(stateType*);
+void printSummary(stateType*);
+void printInstruction(int);
+int parseTraceLevel(char*);
+int parseEngine(char*);
+int parseResolveStage(char*);
+
+// Branch prediction (predictor.c)
+extern const char* predictor_to_str_map[];
+void predictorReset(predictorType* predictor);
+int predictBranch(predictorType* predictor, int pc, int* nextPc);
+void resolveBranch(predictorType* predictor, int pc, int taken, int target, int predictedTaken, int predictHistory);
+int parsePredictor(char*);
+void printPredictorStats(const predictorType* predictor);
+
+// 2-wide pipeline (dualissue.c). Runs from the architectural state to halt.
+// Returns 0, or -1 with sim->error set.
+int runDual(simulatorType* sim);
+
+// Out-of-order core (ooo.c). Runs from the architectural state to halt.
+// Returns 0, or -1 with sim->error set.
+int runOoo(simulatorType* sim);
+
+// Lock-step SIMD engine (simd.c). Runs up to SIMDLANES loaded contexts to halt together,
+// one vector lane each, with the lane memory of sims[0]; each context ends as a run of
+// ENGINE_THREADED would leave it. Returns 0, or -1 with sims[0]->error set and every
+// context as it was.
+int runLanes(simulatorType** sims, int numLanes);
+void simdDestroy(struct simdStruct* simd);
+
+// Pipeline of configurable depth (deep.c). Runs from the architectural state to halt.
+// Returns 0, or -1 with sim->error set.
+int runDeep(simulatorType* sim);
+
+// Per-pc profile (profile.c): a report sorted by the cycles charged to each address,
+// and the same data as folded stacks for flame graph tools. profileUncharged is the
+// cycles no address was charged for, which is never negative.
+long long profileUncharged(const simulatorType* sim);
+void printProfile(FILE* filePtr, const simulatorType* sim);
+void printFoldedProfile(FILE* filePtr, const simulatorType* sim, const char* programName);
+
+// Performance counters (counters.c). Each call writes one JSON object on its own line.
+void printCountersJson(FILE* filePtr, const simulatorType* sim);
+
+// Multi-core runs (multicore.c): pipelines in lock step on one shared memory, their
+// D-caches kept coherent by MESI snooping on a bus that serves one transaction at a time
+
+// What a core's D-cache passes to the bus so the bus knows who is asking
+typedef struct busPortStruct {
+    struct multicoreStruct* multicore;
+    int core;
+} busPortType;
+
+typedef struct busStruct {
+    int arbitration; // cycles to win the bus before every transaction
+    long long busyUntil; // first cycle the bus is free again
+    long long transactions[busUpgrade + 1]; // by enum busAction
+    long long flushes; // transactions another cache had to supply a Modified block for
+    long long busyCycles;
+    long long queuedCycles; // cycles requests waited for an earlier transaction to finish
+} busType;
+
+typedef struct multicoreStruct {
+    int numCores;
+    simulatorType* cores[MAXCORES]; // core 0's context owns the shared memory
+    busPortType ports[MAXCORES];
+    busType bus;
+    char error[MAXERRORLENGTH]; // message for the last failed call
+} multicoreType;
+
+// Creates <numCores> pipeline contexts with the predictor, resolution stage, caches and
+// memory latency of <settings>. Returns NULL if it can't allocate.
+multicoreType* multicoreCreate(int numCores, const simulatorType* settings);
+void multicoreDestroy(multicoreType* multicore);
+
+// Loads one program for every core into the shared memory; each core starts at its
+// entry point with its core number in reg[1]. Returns 0, or -1 with multicore->error set.
+int multicoreLoad(multicoreType* multicore, const char* fileName);
+
+// Steps every core a cycle at a time, lowest core first, until all have halted.
+// Returns 0, or -1 with multicore->error set if a core failed.
+int multicoreRun(multicoreType* multicore);
+
+void printMulticoreStats(const multicoreType* multicore);
+
+#endif
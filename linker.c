@@ -3,6 +3,8 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "lc2kimage.h"
+
 #define MAXSIZE 500
 #define MAXLINELENGTH 1000
 #define MAXFILES 6
@@ -13,6 +15,7 @@ typedef struct RelocationTableEntry RelocationTableEntry;
 typedef struct CombinedFiles CombinedFiles;
 
 static inline void printHexToFile(FILE *, int);
+static inline void writeImage(FILE *, const CombinedFiles*);
 static inline void throwError(char*);
 static inline unsigned int calculateOffset(const SymbolTableEntry*, int, int, const CombinedFiles*);
 static inline RelocationTableEntry* getReloc(FileData* files, int numFiles, const char* label);
@@ -62,16 +65,25 @@ int main(int argc, char *argv[]) {
 	char *inFileStr, *outFileStr;
 	FILE *inFilePtr, *outFilePtr; 
 	unsigned int i, j;
+	int binaryImage = 0;
+
+	if (argc > 1 && !strcmp(argv[1], "-b")) {
+		// Write a binary image (see lc2kimage.h) instead of one hex word per line
+		binaryImage = 1;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
 
     if (argc <= 2 || argc > 8 ) {
-        printf("error: usage: %s <MAIN-object-file> ... <object-file> ... <output-exe-file>, with at most 5 object files\n",
+        printf("error: usage: %s [-b] <MAIN-object-file> ... <object-file> ... <output-exe-file>, with at most 5 object files\n",
 				argv[0]);
 		exit(1);
 	}
 
 	outFileStr = argv[argc - 1];
 
-	outFilePtr = fopen(outFileStr, "w");
+	outFilePtr = fopen(outFileStr, binaryImage ? "wb" : "w");
 	if (outFilePtr == NULL) {
 		printf("error in opening %s\n", outFileStr);
 		exit(1);
@@ -282,6 +294,12 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	if(binaryImage){
+		writeImage(outFilePtr, &combined);
+		fclose(outFilePtr);
+		return 0;
+	}
+
 	// Print the text section
     for(int i = 0; i < combined.textSize; i++){
 		printf("0x%08X\n", combined.text[i]);
@@ -303,6 +321,31 @@ printHexToFile(FILE *outFilePtr, int word) {
     fprintf(outFilePtr, "0x%08X\n", word);
 }
 
+// Writes the header and then the text and data words, which are stored back to back
+static inline void
+writeImage(FILE *outFilePtr, const CombinedFiles* combined) {
+	int* words = malloc((combined->textSize + combined->dataSize + 1) * sizeof(int));
+	if (words == NULL) {
+		throwError("Error: out of memory.\n");
+	}
+	memcpy(words, combined->text, combined->textSize * sizeof(int));
+	memcpy(words + combined->textSize, combined->data, combined->dataSize * sizeof(int));
+
+	imageHeaderType header;
+	memcpy(header.magic, IMAGEMAGIC, sizeof(header.magic));
+	header.version = IMAGEVERSION;
+	header.textSize = combined->textSize;
+	header.dataSize = combined->dataSize;
+	header.entry = 0;
+	header.checksum = imageChecksum(words, combined->textSize + combined->dataSize);
+
+	if (fwrite(&header, sizeof(header), 1, outFilePtr) != 1
+		|| fwrite(words, sizeof(int), combined->textSize + combined->dataSize, outFilePtr) != combined->textSize + combined->dataSize) {
+		throwError("Error: can't write the image.\n");
+	}
+	free(words);
+}
+
 static inline unsigned int 
 calculateOffset(const SymbolTableEntry* entry, int preText, int preData, const CombinedFiles* addition){
 	if(!strcmp(entry->label, "Stack")){
@@ -0,0 +1,112 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memtrace.h"
+
+/*
+ * The buffers form a ring: the simulating thread fills them in order and the writer
+ * writes them in the same order, so records reach the file in the order they were made.
+ */
+
+static void* writerMain(void* arg){
+    memTraceType* trace = arg;
+
+    pthread_mutex_lock(&trace->lock);
+    for (;;) {
+        while (trace->lengths[trace->head] == 0 && !trace->closing) {
+            pthread_cond_wait(&trace->changed, &trace->lock);
+        }
+        int buffer = trace->head;
+        size_t length = trace->lengths[buffer];
+        if (length == 0) break; // closing, and everything has been written
+
+        // The buffer stays marked full while it is written, so the simulator can't reuse it
+        pthread_mutex_unlock(&trace->lock);
+        int failed = fwrite(trace->buffers[buffer], 1, length, trace->file) != length;
+        pthread_mutex_lock(&trace->lock);
+
+        trace->failed |= failed;
+        trace->bytes += length;
+        trace->lengths[buffer] = 0;
+        trace->head = (buffer + 1) % MEMTRACEBUFFERS;
+        pthread_cond_broadcast(&trace->changed);
+    }
+    pthread_mutex_unlock(&trace->lock);
+    return NULL;
+}
+
+memTraceType* memTraceOpen(const char* fileName){
+    memTraceType* trace = calloc(1, sizeof(memTraceType));
+    if (trace == NULL) return NULL;
+
+    for (int buffer = 0; buffer < MEMTRACEBUFFERS; buffer++) {
+        trace->buffers[buffer] = malloc(MEMTRACEBUFFERSIZE);
+        if (trace->buffers[buffer] == NULL) goto fail;
+    }
+
+    trace->file = fopen(fileName, "wb");
+    if (trace->file == NULL) goto fail;
+
+    uint32_t version = MEMTRACEVERSION;
+    if (fwrite(MEMTRACEMAGIC, 1, strlen(MEMTRACEMAGIC), trace->file) != strlen(MEMTRACEMAGIC)
+        || fwrite(&version, sizeof(version), 1, trace->file) != 1) {
+        fclose(trace->file);
+        goto fail;
+    }
+    trace->bytes = strlen(MEMTRACEMAGIC) + sizeof(version);
+
+    trace->fill = trace->buffers[0];
+    trace->end = trace->buffers[0] + MEMTRACEBUFFERSIZE;
+    pthread_mutex_init(&trace->lock, NULL);
+    pthread_cond_init(&trace->changed, NULL);
+    if (pthread_create(&trace->writer, NULL, writerMain, trace)) {
+        fclose(trace->file);
+        goto fail;
+    }
+    return trace;
+
+fail:
+    for (int buffer = 0; buffer < MEMTRACEBUFFERS; buffer++) {
+        free(trace->buffers[buffer]);
+    }
+    free(trace);
+    return NULL;
+}
+
+void memTraceFlush(memTraceType* trace){
+    size_t length = trace->fill - trace->buffers[trace->current];
+    if (length == 0) return;
+
+    pthread_mutex_lock(&trace->lock);
+    trace->lengths[trace->current] = length;
+    pthread_cond_broadcast(&trace->changed);
+
+    trace->current = (trace->current + 1) % MEMTRACEBUFFERS;
+    while (trace->lengths[trace->current] != 0) {
+        pthread_cond_wait(&trace->changed, &trace->lock);
+    }
+    pthread_mutex_unlock(&trace->lock);
+
+    trace->fill = trace->buffers[trace->current];
+    trace->end = trace->fill + MEMTRACEBUFFERSIZE;
+}
+
+int memTraceClose(memTraceType* trace){
+    memTraceFlush(trace);
+
+    pthread_mutex_lock(&trace->lock);
+    trace->closing = 1;
+    pthread_cond_broadcast(&trace->changed);
+    pthread_mutex_unlock(&trace->lock);
+    pthread_join(trace->writer, NULL);
+
+    int failed = trace->failed | (fclose(trace->file) != 0);
+    pthread_mutex_destroy(&trace->lock);
+    pthread_cond_destroy(&trace->changed);
+    for (int buffer = 0; buffer < MEMTRACEBUFFERS; buffer++) {
+        free(trace->buffers[buffer]);
+    }
+    free(trace);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,100 @@
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+/*
+ * Binary trace of every instruction fetch, lw and sw the pipeline makes, for replaying
+ * through memory-system models offline. Records are packed into buffers on the
+ * simulating thread; a background thread writes the full ones out, so the simulation
+ * only waits when the disk falls a whole set of buffers behind.
+ *
+ * File layout: MEMTRACEMAGIC, a 32-bit MEMTRACEVERSION in host byte order, then records
+ * to the end of the file. A record is a kind byte (MEMTRACE_*) followed by varints:
+ *   cycle minus the previous record's cycle (the first record's is against 0)
+ *   zigzag(pc minus the previous record's pc)
+ *   lw and sw only: zigzag(address minus the previous lw/sw address, which starts at 0)
+ *   sw only: zigzag(the value stored)
+ * A fetch's address is its pc. Varints are unsigned LEB128: 7 bits per byte, least
+ * significant first, the top bit set on every byte but the last. zigzag(n) maps
+ * 0, -1, 1, -2, ... to 0, 1, 2, 3, ... so small deltas of either sign stay short.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+
+#define MEMTRACEMAGIC "LC2KMTRC"
+#define MEMTRACEVERSION 1
+
+#define MEMTRACE_FETCH 0
+#define MEMTRACE_LOAD 1
+#define MEMTRACE_STORE 2
+
+#define MEMTRACEBUFFERS 4
+#define MEMTRACEBUFFERSIZE (1 << 20)
+#define MEMTRACEMAXRECORD (1 + 10 + 3 * 5) // kind, 64-bit cycle delta, three 32-bit fields
+
+typedef struct memTraceStruct {
+    // Used only by the simulating thread
+    unsigned char* fill; // next free byte of the buffer being filled
+    unsigned char* end;
+    int current; // index of the buffer being filled
+    long long lastCycle;
+    int lastPc;
+    int lastAddress;
+    long long records;
+
+    // Shared with the writer thread under lock
+    FILE* file;
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    unsigned char* buffers[MEMTRACEBUFFERS];
+    size_t lengths[MEMTRACEBUFFERS]; // bytes waiting to be written, 0 once a buffer is free
+    int head; // next buffer the writer writes
+    int closing;
+    int failed; // a write failed
+    long long bytes; // written so far
+} memTraceType;
+
+// Returns NULL if the file can't be created or the writer can't start
+memTraceType* memTraceOpen(const char* fileName);
+
+// Writes out what is left and frees the trace. Returns 0, or -1 if any write failed.
+int memTraceClose(memTraceType* trace);
+
+// Hands the buffer being filled to the writer, waiting for a free one if need be
+void memTraceFlush(memTraceType* trace);
+
+static inline unsigned char* putVarint(unsigned char* out, unsigned long long value) {
+    while (value >= 0x80) {
+        *out++ = (unsigned char)value | 0x80;
+        value >>= 7;
+    }
+    *out++ = (unsigned char)value;
+    return out;
+}
+
+static inline unsigned int zigzag(int value) {
+    return ((unsigned int)value << 1) ^ (unsigned int)(value >> 31);
+}
+
+static inline void memTraceRecord(memTraceType* trace, long long cycle, int pc, int kind, int address, int value) {
+    if (trace->end - trace->fill < MEMTRACEMAXRECORD) memTraceFlush(trace);
+
+    unsigned char* out = trace->fill;
+    *out++ = (unsigned char)kind;
+    out = putVarint(out, cycle - trace->lastCycle);
+    out = putVarint(out, zigzag(pc - trace->lastPc));
+    if (kind != MEMTRACE_FETCH) {
+        out = putVarint(out, zigzag(address - trace->lastAddress));
+        trace->lastAddress = address;
+    }
+    if (kind == MEMTRACE_STORE) {
+        out = putVarint(out, zigzag(value));
+    }
+    trace->fill = out;
+    trace->lastCycle = cycle;
+    trace->lastPc = pc;
+    trace->records++;
+}
+
+#endif
@@ -0,0 +1,162 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lc2ksim.h"
+
+/*
+ * Several 5-stage pipelines on one memory. Every core is a normal simulation context
+ * whose memory pointers lead to core 0's memory, and the cores step in lock step,
+ * lowest core first; a store is visible to the higher cores in the same cycle.
+ *
+ * The D-caches are timing models like the single-core ones (memory stays
+ * authoritative), and keep MESI states through the bus below. A transaction waits
+ * for the one before it, then holds the bus for the arbitration cycles plus its
+ * transfer: one cycle for an upgrade, memLatency for a fill, and memLatency more
+ * when another cache has to flush a Modified copy first.
+ */
+
+static int busTransaction(void* context, int addr, enum busAction action, int* shared){
+    busPortType* port = context;
+    multicoreType* multicore = port->multicore;
+    busType* bus = &multicore->bus;
+    const simulatorType* requester = multicore->cores[port->core];
+    long long now = requester->state.cycles;
+    int flushed = 0;
+
+    *shared = 0;
+    for (int core = 0; core < multicore->numCores; core++) {
+        cacheStruct* dcache = multicore->cores[core]->dcache;
+        if (core == port->core || dcache == NULL) continue;
+
+        int snooped = cache_instance_snoop(dcache, addr, action);
+        *shared |= snooped != 0 && action == busRead;
+        flushed |= snooped == 2;
+    }
+
+    long long start = now > bus->busyUntil ? now : bus->busyUntil;
+    int transfer = action == busUpgrade ? 1 : requester->memLatency * (1 + flushed);
+    int occupancy = bus->arbitration + (transfer > 0 ? transfer : 1);
+
+    bus->busyUntil = start + occupancy;
+    bus->busyCycles += occupancy;
+    bus->queuedCycles += start - now;
+    bus->transactions[action]++;
+    bus->flushes += flushed;
+
+    // The pipeline already charges memLatency for the block a miss fills
+    return start - now + occupancy - (action == busUpgrade ? 0 : requester->memLatency);
+}
+
+multicoreType* multicoreCreate(int numCores, const simulatorType* settings){
+    multicoreType* multicore = calloc(1, sizeof(multicoreType));
+    if (multicore == NULL) return NULL;
+
+    multicore->numCores = numCores;
+    for (int core = 0; core < numCores; core++) {
+        simulatorType* sim = simulatorCreate();
+        if (sim == NULL) {
+            multicoreDestroy(multicore);
+            return NULL;
+        }
+        multicore->cores[core] = sim;
+        multicore->ports[core] = (busPortType){ multicore, core };
+
+        // Per-cycle traces of several cores would interleave, so the cores run quietly
+        sim->traceLevel = TRACE_NONE;
+        sim->predictor.kind = settings->predictor.kind;
+        sim->resolveStage = settings->resolveStage;
+        sim->icacheConfig = settings->icacheConfig;
+        sim->dcacheConfig = settings->dcacheConfig;
+        sim->memLatency = settings->memLatency;
+    }
+    return multicore;
+}
+
+void multicoreDestroy(multicoreType* multicore){
+    if (multicore == NULL) return;
+    for (int core = 0; core < multicore->numCores; core++) {
+        simulatorDestroy(multicore->cores[core]);
+    }
+    free(multicore);
+}
+
+int multicoreLoad(multicoreType* multicore, const char* fileName){
+    for (int core = 0; core < multicore->numCores; core++) {
+        simulatorType* sim = multicore->cores[core];
+        if (simulatorLoad(sim, fileName)) {
+            memcpy(multicore->error, sim->error, MAXERRORLENGTH);
+            return -1;
+        }
+    }
+
+    const stateType* shared = &multicore->cores[0]->state;
+    for (int core = 0; core < multicore->numCores; core++) {
+        simulatorType* sim = multicore->cores[core];
+        if (core > 0) {
+            sim->state.instrMem = shared->instrMem;
+            sim->state.dataMem = shared->dataMem;
+            sim->state.decoded = shared->decoded;
+            sim->state.written = shared->written;
+        }
+        sim->state.reg[1] = core;
+        sim->newState = sim->state;
+
+        if (sim->dcache != NULL) {
+            sim->dcache->bus = busTransaction;
+            sim->dcache->busContext = multicore->ports + core;
+        }
+    }
+
+    int arbitration = multicore->bus.arbitration;
+    memset(&multicore->bus, 0, sizeof(busType));
+    multicore->bus.arbitration = arbitration;
+    return 0;
+}
+
+int multicoreRun(multicoreType* multicore){
+    int running;
+    do {
+        running = 0;
+        for (int core = 0; core < multicore->numCores; core++) {
+            simulatorType* sim = multicore->cores[core];
+            if (sim->halted) continue;
+
+            int status = simulatorStep(sim);
+            if (status < 0) {
+                memcpy(multicore->error, sim->error, MAXERRORLENGTH);
+                return -1;
+            }
+            running += !status;
+        }
+    } while (running);
+    return 0;
+}
+
+void printMulticoreStats(const multicoreType* multicore){
+    int cycles = 0;
+    char name[32];
+
+    for (int core = 0; core < multicore->numCores; core++) {
+        const simulatorType* sim = multicore->cores[core];
+        if ((int)sim->state.cycles > cycles) cycles = sim->state.cycles;
+
+        printf("core %d: %d cycles, %lld instructions, CPI %.3f, %lld memory stall cycles\n", core, sim->state.cycles,
+            sim->counters.retired, sim->counters.retired ? (double)sim->state.cycles / sim->counters.retired : 0.0,
+            sim->memStallCycles);
+        if (sim->icache != NULL) {
+            snprintf(name, sizeof(name), "core %d I-cache", core);
+            cache_instance_print_stats(sim->icache, name);
+        }
+        if (sim->dcache != NULL) {
+            snprintf(name, sizeof(name), "core %d D-cache", core);
+            cache_instance_print_stats(sim->dcache, name);
+        }
+    }
+
+    const busType* bus = &multicore->bus;
+    long long transactions = bus->transactions[busRead] + bus->transactions[busReadExclusive] + bus->transactions[busUpgrade];
+    printf("bus: %lld transactions (%lld reads, %lld read-exclusives, %lld upgrades), %lld flushes\n", transactions,
+        bus->transactions[busRead], bus->transactions[busReadExclusive], bus->transactions[busUpgrade], bus->flushes);
+    printf("bus: busy %lld of %d cycles (%.2f%% utilization), %lld cycles queued\n", bus->busyCycles, cycles,
+        cycles ? 100.0 * bus->busyCycles / cycles : 0.0, bus->queuedCycles);
+}
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lc2ksim.h"
+
+/*
+ * Out-of-order timing model in the style of Tomasulo with a reorder buffer. Each
+ * cycle, in this order:
+ *   commit   - up to width finished instructions leave the ROB head in program order,
+ *              writing registers and memory; a mispredicted beq flushes everything
+ *              behind it and restarts fetch on the right path
+ *   complete - instructions whose latency has run out broadcast their result to the
+ *              entries waiting on them
+ *   issue    - up to width entries whose operands are ready start executing, oldest
+ *              first; loads also wait for the LSQ check below
+ *   dispatch - up to width instructions are fetched, renamed through the RAT and put
+ *              in the ROB, a reservation station and (lw/sw) the LSQ
+ * The ROB entries double as the reservation stations and the load/store queue;
+ * rsSize and lsqSize cap how many of them may be waiting to issue or be memory
+ * operations. A load issues once every older store has its address; it takes the
+ * data of the youngest older store to the same address, or reads memory, which
+ * only ever holds committed stores.
+ */
+
+#define ROB_DISPATCHED 0 // waiting in a reservation station
+#define ROB_ISSUED 1 // executing
+#define ROB_DONE 2 // result ready, waiting to commit
+
+typedef struct robEntryStruct {
+    const decodedType* decoded;
+    int pc;
+    int status; // ROB_*
+    int tagA; // ROB index producing valA, -1 once it is known
+    int tagB;
+    int valA;
+    int valB;
+    int address; // lw/sw, once tagA is resolved
+    int result; // register value, or eq for beq
+    int doneCycle;
+    int predictedTaken;
+    int predictHistory;
+} robEntryType;
+
+typedef struct oooStruct {
+    robEntryType rob[MAXROBSIZE];
+    int head;
+    int count;
+    int rat[NUMREGS]; // ROB index of the newest writer of each register, -1 for the register file
+    int waiting; // entries in reservation stations
+    int memOps; // lw/sw in the LSQ
+    int fetchPc;
+    int fetchStopped; // a halt is in the ROB, or fetch ran into something it can't rename
+} oooType;
+
+static inline int robIndex(const oooType* core, int age){
+    return (core->head + age) % MAXROBSIZE;
+}
+
+static int latencyOf(const oooConfigType* config, int op){
+    switch (op) {
+        case LW: return config->loadLatency;
+        case BEQ: return config->branchLatency;
+        default: return config->aluLatency;
+    }
+}
+
+// Sends a finished result to every entry waiting on ROB index <tag>
+static void broadcast(oooType* core, int tag, int value){
+    for (int age = 0; age < core->count; age++) {
+        robEntryType* entry = core->rob + robIndex(core, age);
+        if (entry->tagA == tag) {
+            entry->valA = value;
+            entry->tagA = -1;
+            entry->address = value + entry->decoded->offset;
+        }
+        if (entry->tagB == tag) {
+            entry->valB = value;
+            entry->tagB = -1;
+        }
+    }
+}
+
+// Finds the value a load at ROB age <age> reads. Returns 0 if it has to wait for an older store.
+static int loadValue(oooType* core, const stateType* machine, int age, int* value, long long* storeForwards){
+    const robEntryType* load = core->rob + robIndex(core, age);
+
+    for (int older = age - 1; older >= 0; older--) {
+        const robEntryType* store = core->rob + robIndex(core, older);
+        if (store->decoded->opcode != SW) continue;
+        if (store->tagA >= 0) return 0; // address unknown, might alias
+        if (store->address != load->address) continue;
+        if (store->tagB >= 0) return 0; // data not ready yet
+        *value = store->valB;
+        (*storeForwards)++;
+        return 1;
+    }
+    // Wrong-path loads can compute any address; they get a 0 and are flushed before commit
+    *value = load->address >= 0 && load->address < NUMMEMORY ? machine->dataMem[load->address] : 0;
+    return 1;
+}
+
+// Reads a source register through the RAT at dispatch
+static void renameSource(const oooType* core, const stateType* machine, int reg, int* tag, int* value){
+    int producer = core->rat[reg];
+
+    *tag = -1;
+    if (producer < 0) {
+        *value = machine->reg[reg];
+    } else if (core->rob[producer].status == ROB_DONE) {
+        *value = core->rob[producer].result;
+    } else {
+        *tag = producer;
+    }
+}
+
+static void flush(simulatorType* sim, oooType* core, int pc){
+    // Everything still in the ROB is younger than the committing beq
+    sim->counters.squashedSlots += core->count;
+    core->count = 0;
+    core->waiting = 0;
+    core->memOps = 0;
+    for (int reg = 0; reg < NUMREGS; reg++) {
+        core->rat[reg] = -1;
+    }
+    core->fetchPc = pc;
+    core->fetchStopped = 0;
+}
+
+// Commits from the ROB head. Returns 1 once the halt commits.
+static int commit(simulatorType* sim, oooType* core){
+    stateType* machine = &sim->state;
+    const oooConfigType* config = &sim->ooo;
+
+    for (int slot = 0; slot < config->width && core->count > 0; slot++) {
+        int index = core->head;
+        robEntryType* entry = core->rob + index;
+        const decodedType* decoded = entry->decoded;
+
+        if (entry->status != ROB_DONE) break;
+
+        sim->counters.retired++;
+        sim->counters.opcodeMix[decoded->opcode]++;
+        core->head = (core->head + 1) % MAXROBSIZE;
+        core->count--;
+
+        if (decoded->writesReg) {
+            machine->reg[decoded->destReg] = entry->result;
+            if (core->rat[decoded->destReg] == index) core->rat[decoded->destReg] = -1;
+        }
+        if (decoded->opcode == LW || decoded->opcode == SW) {
+            core->memOps--;
+        }
+
+        switch (decoded->opcode) {
+            case SW:
+            storeWord(machine, entry->address, entry->valB);
+            break;
+            case HALT:
+            machine->pc = entry->pc + 1;
+            return 1;
+            case BEQ:
+            {
+                int target = entry->pc + 1 + decoded->offset;
+                resolveBranch(&sim->predictor, entry->pc, entry->result, target, entry->predictedTaken, entry->predictHistory);
+                if (entry->result != entry->predictedTaken) {
+                    flush(sim, core, entry->result ? target : entry->pc + 1);
+                    return 0;
+                }
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static void complete(oooType* core, int cycles){
+    for (int age = 0; age < core->count; age++) {
+        int index = robIndex(core, age);
+        robEntryType* entry = core->rob + index;
+        if (entry->status == ROB_ISSUED && entry->doneCycle <= cycles) {
+            entry->status = ROB_DONE;
+            if (entry->decoded->writesReg) broadcast(core, index, entry->result);
+        }
+    }
+}
+
+static void issue(simulatorType* sim, oooType* core, int cycles){
+    const oooConfigType* config = &sim->ooo;
+    int issued = 0;
+
+    for (int age = 0; age < core->count && issued < config->width; age++) {
+        robEntryType* entry = core->rob + robIndex(core, age);
+        if (entry->status != ROB_DISPATCHED || entry->tagA >= 0 || entry->tagB >= 0) continue;
+
+        switch (entry->decoded->opcode) {
+            case ADD:
+            entry->result = entry->valA + entry->valB;
+            break;
+            case NOR:
+            entry->result = ~(entry->valA | entry->valB);
+            break;
+            case LW:
+            if (!loadValue(core, &sim->state, age, &entry->result, &sim->counters.storeForwards)) continue;
+            break;
+            case BEQ:
+            entry->result = entry->valA == entry->valB;
+            break;
+        }
+        entry->status = ROB_ISSUED;
+        entry->doneCycle = cycles + latencyOf(config, entry->decoded->opcode) - 1;
+        core->waiting--;
+        issued++;
+    }
+}
+
+static void dispatch(simulatorType* sim, oooType* core){
+    stateType* machine = &sim->state;
+    const oooConfigType* config = &sim->ooo;
+
+    for (int slot = 0; slot < config->width && !core->fetchStopped; slot++) {
+        if (core->count == config->robSize) {
+            sim->counters.robFullStalls++;
+            break;
+        }
+        if (core->waiting == config->rsSize) break;
+
+        int pc = core->fetchPc;
+        const decodedType* decoded = pc >= 0 && pc < NUMMEMORY ? fetchDecoded(machine, pc) : NULL;
+        int isMem = decoded != NULL && (decoded->opcode == LW || decoded->opcode == SW);
+
+        if (decoded == NULL || (decoded->writesReg && decoded->destReg >= NUMREGS)) {
+            // Only the wrong path gets here in a working program; wait for the flush
+            core->fetchStopped = 1;
+            break;
+        }
+        if (isMem && core->memOps == config->lsqSize) break;
+
+        int index = robIndex(core, core->count);
+        robEntryType* entry = core->rob + index;
+        memset(entry, 0, sizeof(robEntryType));
+        entry->decoded = decoded;
+        entry->pc = pc;
+        entry->tagA = entry->tagB = -1;
+
+        if (decoded->readsRegA) renameSource(core, machine, decoded->regA, &entry->tagA, &entry->valA);
+        if (decoded->readsRegB) renameSource(core, machine, decoded->regB, &entry->tagB, &entry->valB);
+        if (entry->tagA < 0) entry->address = entry->valA + decoded->offset;
+        if (decoded->writesReg) core->rat[decoded->destReg] = index;
+
+        core->count++;
+        core->memOps += isMem;
+        core->fetchPc = pc + 1;
+
+        switch (decoded->opcode) {
+            case ADD:
+            case NOR:
+            case LW:
+            case SW:
+            case BEQ:
+            entry->status = ROB_DISPATCHED;
+            core->waiting++;
+            break;
+            default:
+            // halt, noop and jalr (a noop here) have nothing to execute
+            entry->status = ROB_DONE;
+            break;
+        }
+
+        if (decoded->opcode == HALT) {
+            core->fetchStopped = 1;
+        } else if (decoded->opcode == BEQ) {
+            entry->predictHistory = sim->predictor.history;
+            entry->predictedTaken = predictBranch(&sim->predictor, pc, &core->fetchPc);
+            if (entry->predictedTaken) break; // a taken beq ends the fetch group
+        }
+    }
+}
+
+int runOoo(simulatorType* sim){
+    const oooConfigType* config = &sim->ooo;
+
+    if (config->robSize < 1 || config->robSize > MAXROBSIZE || config->rsSize < 1 || config->lsqSize < 1
+        || config->width < 1 || config->aluLatency < 1 || config->loadLatency < 1 || config->branchLatency < 1) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: out-of-order sizes and latencies must be positive, with at most %d ROB entries\n",
+            MAXROBSIZE);
+        return -1;
+    }
+
+    oooType* core = calloc(1, sizeof(oooType));
+    if (core == NULL) {
+        snprintf(sim->error, MAXERRORLENGTH, "error: out of memory\n");
+        return -1;
+    }
+    for (int reg = 0; reg < NUMREGS; reg++) {
+        core->rat[reg] = -1;
+    }
+    core->fetchPc = sim->state.pc;
+
+    int status = 0;
+    for (;;) {
+        sim->state.cycles++;
+        if (commit(sim, core)) break;
+        complete(core, sim->state.cycles);
+        issue(sim, core, sim->state.cycles);
+        dispatch(sim, core);
+
+        if (core->fetchStopped && core->count == 0) {
+            // Nothing older is left to flush it, so fetch stopped on the committed path
+            int pc = core->fetchPc;
+            if (pc < 0 || pc >= NUMMEMORY) {
+                snprintf(sim->error, MAXERRORLENGTH, "error: pc %d is outside memory\n", pc);
+            } else {
+                snprintf(sim->error, MAXERRORLENGTH, "error: can't execute the instruction at pc %d\n", pc);
+            }
+            status = -1;
+            break;
+        }
+    }
+
+    free(core);
+    sim->newState = sim->state;
+    return status;
+}
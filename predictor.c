@@ -0,0 +1,119 @@
+#include <string.h>
+
+#include "lc2ksim.h"
+
+/*
+ * Branch prediction for the IF stage. The BTB supplies the target of a beq that
+ * has been taken before, and the direction predictor decides whether to use it.
+ * Tables are trained when the branch resolves, so the global history only holds
+ * resolved outcomes; each beq carries the history it was predicted with so that
+ * training hits the same gshare counter the prediction read.
+ */
+
+const char* predictor_to_str_map[] = {
+    "none",
+    "backward",
+    "bimodal",
+    "gshare",
+    "tournament"
+};
+
+static inline int counterTaken(unsigned char counter) {
+    return counter >= 2;
+}
+
+static inline unsigned char trainCounter(unsigned char counter, int taken) {
+    if (taken) return counter < 3 ? counter + 1 : 3;
+    return counter > 0 ? counter - 1 : 0;
+}
+
+static inline int bimodalIndex(int pc) {
+    return pc & (PREDICTORSIZE - 1);
+}
+
+static inline int gshareIndex(int pc, int history) {
+    return (pc ^ history) & (PREDICTORSIZE - 1);
+}
+
+void predictorReset(predictorType* predictor){
+    int kind = predictor->kind;
+
+    memset(predictor, 0, sizeof(predictorType));
+    predictor->kind = kind;
+    // Counters start weakly not-taken and the chooser weakly prefers bimodal
+    memset(predictor->bimodal, 1, sizeof(predictor->bimodal));
+    memset(predictor->gshare, 1, sizeof(predictor->gshare));
+    memset(predictor->chooser, 1, sizeof(predictor->chooser));
+    for (int entry = 0; entry < BTBSIZE; entry++) {
+        predictor->btb[entry].pc = -1;
+    }
+}
+
+int predictBranch(predictorType* predictor, int pc, int* nextPc){
+    // Returns 1 and sets <nextPc> to the target if the beq at <pc> is predicted taken
+    if (predictor->kind == PREDICT_NONE) return 0;
+
+    const btbEntryType* entry = predictor->btb + (pc & (BTBSIZE - 1));
+    if (entry->pc != pc) return 0;
+
+    int taken = 0;
+    switch (predictor->kind) {
+        case PREDICT_BACKWARD:
+        taken = entry->target <= pc;
+        break;
+        case PREDICT_BIMODAL:
+        taken = counterTaken(predictor->bimodal[bimodalIndex(pc)]);
+        break;
+        case PREDICT_GSHARE:
+        taken = counterTaken(predictor->gshare[gshareIndex(pc, predictor->history)]);
+        break;
+        case PREDICT_TOURNAMENT:
+        taken = counterTaken(predictor->chooser[bimodalIndex(pc)])
+            ? counterTaken(predictor->gshare[gshareIndex(pc, predictor->history)])
+            : counterTaken(predictor->bimodal[bimodalIndex(pc)]);
+        break;
+    }
+
+    if (taken) *nextPc = entry->target;
+    return taken;
+}
+
+void resolveBranch(predictorType* predictor, int pc, int taken, int target, int predictedTaken, int predictHistory){
+    predictor->branches++;
+    if (taken != predictedTaken) predictor->mispredicts++;
+    if (predictor->kind == PREDICT_NONE) return;
+
+    // Counted here rather than at fetch, where wrong-path and refetched beqs would count too
+    btbEntryType* entry = predictor->btb + (pc & (BTBSIZE - 1));
+    if (entry->pc != pc) predictor->btbMisses++;
+    if (taken) {
+        entry->pc = pc;
+        entry->target = target;
+    }
+
+    unsigned char* bimodal = predictor->bimodal + bimodalIndex(pc);
+    unsigned char* gshare = predictor->gshare + gshareIndex(pc, predictHistory);
+
+    if (predictor->kind == PREDICT_TOURNAMENT && counterTaken(*bimodal) != counterTaken(*gshare)) {
+        // Move the chooser towards whichever component was right
+        unsigned char* chooser = predictor->chooser + bimodalIndex(pc);
+        *chooser = trainCounter(*chooser, counterTaken(*gshare) == taken);
+    }
+    *bimodal = trainCounter(*bimodal, taken);
+    *gshare = trainCounter(*gshare, taken);
+    predictor->history = ((predictor->history << 1) | taken) & (PREDICTORSIZE - 1);
+}
+
+int parsePredictor(char* name){
+    // Returns -1 for an unknown predictor so main can print the usage message
+    for (int kind = PREDICT_NONE; kind <= PREDICT_TOURNAMENT; kind++) {
+        if (!strcmp(name, predictor_to_str_map[kind])) return kind;
+    }
+    return -1;
+}
+
+void printPredictorStats(const predictorType* predictor){
+    double accuracy = predictor->branches ? 100.0 * (predictor->branches - predictor->mispredicts) / predictor->branches : 100.0;
+    printf("Branch predictor %s: %lld branches, %lld mispredicted (%.2f%% accuracy), %lld BTB misses\n",
+        predictor_to_str_map[predictor->kind], predictor->branches, predictor->mispredicts, accuracy, predictor->btbMisses);
+}
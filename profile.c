@@ -0,0 +1,128 @@
+#include <stdlib.h>
+
+#include "lc2ksim.h"
+
+/*
+ * Reports for the per-pc profile. Every address is charged a cycle each time it
+ * retires, plus the bubbles, squashed slots and memory stalls the pipeline lost on
+ * its account. What no address is charged for is pipeline fill and drain.
+ */
+
+typedef struct profileLineStruct {
+    int pc;
+    long long cycles;
+} profileLineType;
+
+static long long chargedCycles(const profileEntryType* entry){
+    return entry->retired + entry->stalls + entry->squashes + entry->memStalls;
+}
+
+static int compareLines(const void* a, const void* b){
+    // Most cycles first, then by address
+    const profileLineType* lineA = a;
+    const profileLineType* lineB = b;
+    if (lineA->cycles != lineB->cycles) return lineA->cycles < lineB->cycles ? 1 : -1;
+    return lineA->pc - lineB->pc;
+}
+
+// The addresses that were charged anything, sorted. Returns NULL if there are none or it can't allocate.
+static profileLineType* collectLines(const simulatorType* sim, int* numLines){
+    *numLines = 0;
+    if (sim->profile == NULL) return NULL;
+
+    for (int pc = 0; pc < NUMMEMORY; pc++) {
+        *numLines += chargedCycles(sim->profile + pc) != 0;
+    }
+    profileLineType* lines = malloc((*numLines + 1) * sizeof(profileLineType));
+    if (lines == NULL) {
+        *numLines = 0;
+        return NULL;
+    }
+
+    int line = 0;
+    for (int pc = 0; pc < NUMMEMORY; pc++) {
+        long long cycles = chargedCycles(sim->profile + pc);
+        if (cycles == 0) continue;
+        lines[line].pc = pc;
+        lines[line].cycles = cycles;
+        line++;
+    }
+    qsort(lines, *numLines, sizeof(profileLineType), compareLines);
+    return lines;
+}
+
+// Disassembles like printInstruction, into <buffer> with <separator> between the fields
+static void formatInstruction(char* buffer, size_t size, int instr, char separator){
+    int op = opcode(instr);
+
+    switch (op) {
+        case ADD:
+        case NOR:
+        case LW:
+        case SW:
+        case BEQ:
+        snprintf(buffer, size, "%s%c%d%c%d%c%d", opcode_to_str_map[op], separator, field0(instr), separator,
+            field1(instr), separator, convertNum(field2(instr)));
+        break;
+        case JALR:
+        snprintf(buffer, size, "%s%c%d%c%d", opcode_to_str_map[op], separator, field0(instr), separator, field1(instr));
+        break;
+        case HALT:
+        case NOOP:
+        snprintf(buffer, size, "%s", opcode_to_str_map[op]);
+        break;
+        default:
+        snprintf(buffer, size, ".fill%c%d", separator, instr);
+        break;
+    }
+}
+
+long long profileUncharged(const simulatorType* sim){
+    long long charged = 0;
+    if (sim->profile != NULL) {
+        for (int pc = 0; pc < NUMMEMORY; pc++) charged += chargedCycles(sim->profile + pc);
+    }
+    return sim->state.cycles - charged;
+}
+
+void printProfile(FILE* filePtr, const simulatorType* sim){
+    int numLines;
+    profileLineType* lines = collectLines(sim, &numLines);
+    char instruction[64];
+
+    fprintf(filePtr, "profile of %d cycles, %lld instructions retired\n", sim->state.cycles, sim->counters.retired);
+    fprintf(filePtr, "%6s  %-20s %12s %10s %10s %10s %12s %7s\n",
+        "pc", "instruction", "retired", "stalls", "squashes", "memstalls", "cycles", "%");
+
+    for (int line = 0; line < numLines; line++) {
+        const profileEntryType* entry = sim->profile + lines[line].pc;
+        formatInstruction(instruction, sizeof(instruction), sim->state.instrMem[lines[line].pc], ' ');
+        fprintf(filePtr, "%6d  %-20s %12lld %10lld %10lld %10lld %12lld %6.2f%%\n", lines[line].pc, instruction,
+            entry->retired, entry->stalls, entry->squashes, entry->memStalls, lines[line].cycles,
+            sim->state.cycles ? 100.0 * lines[line].cycles / sim->state.cycles : 0.0);
+    }
+    fprintf(filePtr, "%lld cycles not charged to an instruction (pipeline fill and drain)\n", profileUncharged(sim));
+
+    free(lines);
+}
+
+void printFoldedProfile(FILE* filePtr, const simulatorType* sim, const char* programName){
+    // One "program;pc<N>_<instruction>;<kind> <cycles>" line per nonzero count
+    int numLines;
+    profileLineType* lines = collectLines(sim, &numLines);
+    char instruction[64];
+
+    for (int line = 0; line < numLines; line++) {
+        int pc = lines[line].pc;
+        const profileEntryType* entry = sim->profile + pc;
+        const char* kinds[] = { "retired", "stall", "squash", "memstall" };
+        long long counts[] = { entry->retired, entry->stalls, entry->squashes, entry->memStalls };
+
+        formatInstruction(instruction, sizeof(instruction), sim->state.instrMem[pc], '_');
+        for (int kind = 0; kind < 4; kind++) {
+            if (counts[kind]) fprintf(filePtr, "%s;pc%d_%s;%s %lld\n", programName, pc, instruction, kinds[kind], counts[kind]);
+        }
+    }
+
+    free(lines);
+}
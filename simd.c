@@ -0,0 +1,314 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "lc2ksim.h"
+
+/*
+ * Lock-step SIMD functional engine. Up to SIMDLANES contexts run together, context n in
+ * lane n of every vector: each register is one vector, and dataMem is interleaved so that
+ * word a of every lane sits in the one vector at mem[a * SIMDLANES]. Every step executes
+ * the instruction at the lowest pc of any running lane, masked to the lanes at that pc.
+ * Lanes that branch away wait for the others to catch up, so a loop whose trip count
+ * differs between lanes runs diverged only for its extra iterations, and the lanes
+ * reconverge where it exits. add, nor and beq are vector ops; lw and sw are single vector
+ * loads and stores when every lane uses the same address, and gathers and scatters
+ * otherwise.
+ *
+ * The contexts usually hold one program with different data. Where their instruction
+ * words differ at a pc (a .fill the program never executes, or unrelated programs), the
+ * step only takes the lanes that agree with the lowest of them, and the rest run in a
+ * later step.
+ */
+
+typedef int laneVector __attribute__((vector_size(SIMDLANES * sizeof(int))));
+typedef unsigned int laneMaskType; // bit n for lane n
+
+#define CODE_UNCHECKED 0
+#define CODE_UNIFORM 1 // every lane has the same word at this pc
+#define CODE_MIXED 2
+
+#define COUNTFLUSH (1 << 30) // steps between flushes of the per-lane instruction counts
+
+typedef struct simdStruct {
+    int* mem; // NUMMEMORY * SIMDLANES words, reserved like memoryType
+    pageMaskType written; // pages of mem that may be nonzero
+    laneMaskType pageLanes[NUMPAGES]; // lanes that may have nonzero words in each page
+    unsigned char code[NUMMEMORY]; // CODE_* for each pc in the current run
+} simdType;
+
+static const laneVector laneIndex = {
+    0, 1, 2, 3,
+#if SIMDLANES >= 8
+    4, 5, 6, 7,
+#endif
+#if SIMDLANES == 16
+    8, 9, 10, 11, 12, 13, 14, 15
+#endif
+};
+
+static const laneVector laneBit = {
+    1 << 0, 1 << 1, 1 << 2, 1 << 3,
+#if SIMDLANES >= 8
+    1 << 4, 1 << 5, 1 << 6, 1 << 7,
+#endif
+#if SIMDLANES == 16
+    1 << 8, 1 << 9, 1 << 10, 1 << 11, 1 << 12, 1 << 13, 1 << 14, 1 << 15
+#endif
+};
+
+// -1 in the lanes set in <lanes>, 0 elsewhere
+static inline laneVector maskVector(laneMaskType lanes){
+    return (laneBit & (int)lanes) != 0;
+}
+
+// One bit per lane of a compare result (lanes that are -1)
+static inline laneMaskType maskBits(laneVector mask){
+#if defined(__AVX512F__)
+    return _mm512_cmplt_epi32_mask((__m512i)mask, _mm512_setzero_si512());
+#elif defined(__AVX2__)
+    return _mm256_movemask_ps((__m256)mask);
+#elif defined(__SSE2__)
+    return _mm_movemask_ps((__m128)mask);
+#else
+    laneMaskType bits = 0;
+    for (int lane = 0; lane < SIMDLANES; lane++) bits |= (laneMaskType)(mask[lane] & 1) << lane;
+    return bits;
+#endif
+}
+
+static inline laneVector blend(laneVector mask, laneVector a, laneVector b){
+    return (a & mask) | (b & ~mask);
+}
+
+// The words at <addr> of the lanes in <lanes> (where they must be in range), <old> elsewhere
+static inline laneVector gather(const int* mem, laneVector addr, laneMaskType lanes, laneVector old){
+    laneVector index = addr * SIMDLANES + laneIndex;
+#if defined(__AVX512F__)
+    return (laneVector)_mm512_mask_i32gather_epi32((__m512i)old, lanes, (__m512i)index, mem, sizeof(int));
+#elif defined(__AVX2__)
+    return (laneVector)_mm256_mask_i32gather_epi32((__m256i)old, mem, (__m256i)index, (__m256i)maskVector(lanes), sizeof(int));
+#else
+    for (; lanes; lanes &= lanes - 1) {
+        int lane = __builtin_ctz(lanes);
+        old[lane] = mem[index[lane]];
+    }
+    return old;
+#endif
+}
+
+static inline void scatter(int* mem, laneVector addr, laneMaskType lanes, laneVector value){
+    laneVector index = addr * SIMDLANES + laneIndex;
+#if defined(__AVX512F__)
+    _mm512_mask_i32scatter_epi32(mem, lanes, (__m512i)index, (__m512i)value, sizeof(int));
+#else
+    for (; lanes; lanes &= lanes - 1) {
+        int lane = __builtin_ctz(lanes);
+        mem[index[lane]] = value[lane];
+    }
+#endif
+}
+
+static simdType* simdCreate(void){
+    simdType* simd = calloc(1, sizeof(simdType));
+    if (simd == NULL) return NULL;
+
+    simd->mem = mmap(NULL, (size_t)NUMMEMORY * SIMDLANES * sizeof(int), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (simd->mem == MAP_FAILED) {
+        free(simd);
+        return NULL;
+    }
+    return simd;
+}
+
+void simdDestroy(simdType* simd){
+    if (simd == NULL) return;
+    munmap(simd->mem, (size_t)NUMMEMORY * SIMDLANES * sizeof(int));
+    free(simd);
+}
+
+// Zeroes what the last run left in lane memory and interleaves the written pages of each context into it
+static void loadLanes(simdType* simd, simulatorType** sims, int numLanes){
+    for (int page = 0; page < NUMPAGES; page++) {
+        if (simd->written >> page & 1) memset(simd->mem + ((size_t)page << PAGESHIFT) * SIMDLANES, 0, PAGEWORDS * SIMDLANES * sizeof(int));
+    }
+    simd->written = 0;
+    memset(simd->pageLanes, 0, sizeof(simd->pageLanes));
+
+    for (int lane = 0; lane < numLanes; lane++) {
+        const stateType* state = &sims[lane]->state;
+        for (int page = 0; page < NUMPAGES; page++) {
+            if (!(state->written->data >> page & 1)) continue;
+            int* row = simd->mem + ((size_t)page << PAGESHIFT) * SIMDLANES + lane;
+            const int* words = state->dataMem + (page << PAGESHIFT);
+            for (int word = 0; word < PAGEWORDS; word++) row[word * SIMDLANES] = words[word];
+            simd->pageLanes[page] |= 1u << lane;
+        }
+        simd->written |= state->written->data;
+    }
+}
+
+// Copies the pages each lane may have written back out to its context
+static void storeLanes(const simdType* simd, simulatorType** sims){
+    for (int page = 0; page < NUMPAGES; page++) {
+        for (laneMaskType lanes = simd->pageLanes[page]; lanes; lanes &= lanes - 1) {
+            int lane = __builtin_ctz(lanes);
+            stateType* state = &sims[lane]->state;
+            const int* row = simd->mem + ((size_t)page << PAGESHIFT) * SIMDLANES + lane;
+            int* words = state->dataMem + (page << PAGESHIFT);
+            for (int word = 0; word < PAGEWORDS; word++) words[word] = row[word * SIMDLANES];
+            markWritten(&state->written->data, page << PAGESHIFT);
+        }
+    }
+}
+
+// The lanes whose instruction word at <pc> matches that of the lowest lane in <lanes>
+static laneMaskType agreeingLanes(simdType* simd, simulatorType** sims, int numLanes, int pc, laneMaskType lanes){
+    if (simd->code[pc] == CODE_UNCHECKED) {
+        simd->code[pc] = CODE_UNIFORM;
+        for (int lane = 1; lane < numLanes; lane++) {
+            if (sims[lane]->state.instrMem[pc] != sims[0]->state.instrMem[pc]) simd->code[pc] = CODE_MIXED;
+        }
+    }
+    if (simd->code[pc] == CODE_UNIFORM) return lanes;
+
+    int word = sims[__builtin_ctz(lanes)]->state.instrMem[pc];
+    laneMaskType agreeing = 0;
+    for (laneMaskType rest = lanes; rest; rest &= rest - 1) {
+        int lane = __builtin_ctz(rest);
+        if (sims[lane]->state.instrMem[pc] == word) agreeing |= 1u << lane;
+    }
+    return agreeing;
+}
+
+int runLanes(simulatorType** sims, int numLanes){
+    simulatorType* first = sims[0];
+
+    if (numLanes < 1 || numLanes > SIMDLANES) {
+        snprintf(first->error, MAXERRORLENGTH, "error: the SIMD engine runs 1 to %d contexts at once\n", SIMDLANES);
+        return -1;
+    }
+    if (first->simd == NULL && (first->simd = simdCreate()) == NULL) {
+        snprintf(first->error, MAXERRORLENGTH, "error: out of memory for SIMD lanes\n");
+        return -1;
+    }
+    simdType* simd = first->simd;
+
+    laneVector reg[NUMREGS], pcs = { 0 }, counts = { 0 };
+    long long executed[SIMDLANES] = { 0 };
+    laneMaskType running = 0;
+
+    for (int r = 0; r < NUMREGS; r++) {
+        for (int lane = 0; lane < numLanes; lane++) reg[r][lane] = sims[lane]->state.reg[r];
+    }
+    for (int lane = 0; lane < numLanes; lane++) {
+        pcs[lane] = sims[lane]->state.pc;
+        if (!sims[lane]->halted) running |= 1u << lane;
+    }
+    loadLanes(simd, sims, numLanes);
+    memset(simd->code, CODE_UNCHECKED, sizeof(simd->code));
+
+    int* mem = simd->mem;
+    long long steps = 0;
+
+    while (running) {
+        // Run the lanes at the lowest pc; when none have diverged that is all of them
+        int pc = pcs[__builtin_ctz(running)];
+        laneMaskType here = maskBits(pcs == pc) & running;
+        if (here != running) {
+            for (laneMaskType rest = running; rest; rest &= rest - 1) {
+                int lane = __builtin_ctz(rest);
+                if (pcs[lane] < pc) pc = pcs[lane];
+            }
+            here = maskBits(pcs == pc) & running;
+        }
+
+        if (pc < 0 || pc >= NUMMEMORY) {
+            snprintf(first->error, MAXERRORLENGTH, "error: lane %d branched to pc %d, outside memory\n", __builtin_ctz(here), pc);
+            return -1;
+        }
+        here = agreeingLanes(simd, sims, numLanes, pc, here);
+
+        const decodedType* instr = fetchDecoded(&sims[__builtin_ctz(here)]->state, pc);
+        laneVector mask = maskVector(here);
+        laneVector next = (laneVector){ 0 } + (pc + 1);
+        laneVector addr;
+        laneMaskType bad;
+
+        if (instr->writesReg && instr->destReg >= NUMREGS) {
+            snprintf(first->error, MAXERRORLENGTH, "error: the instruction at pc %d writes register %d\n", pc, instr->destReg);
+            return -1;
+        }
+
+        switch (instr->opcode) {
+            case ADD:
+            reg[instr->destReg] = blend(mask, reg[instr->regA] + reg[instr->regB], reg[instr->destReg]);
+            break;
+            case NOR:
+            reg[instr->destReg] = blend(mask, ~(reg[instr->regA] | reg[instr->regB]), reg[instr->destReg]);
+            break;
+            case LW:
+            case SW:
+            addr = reg[instr->regA] + instr->offset;
+            bad = maskBits((addr < 0) | (addr >= NUMMEMORY)) & here;
+            if (bad) {
+                int lane = __builtin_ctz(bad);
+                snprintf(first->error, MAXERRORLENGTH, "error: lane %d accessed address %d at pc %d, outside memory\n",
+                    lane, addr[lane], pc);
+                return -1;
+            }
+
+            int uniform = (maskBits(addr == addr[__builtin_ctz(here)]) & here) == here;
+            if (instr->opcode == LW) {
+                reg[instr->destReg] = uniform
+                    ? blend(mask, *(laneVector*)(mem + addr[__builtin_ctz(here)] * SIMDLANES), reg[instr->destReg])
+                    : gather(mem, addr, here, reg[instr->destReg]);
+            } else if (uniform) {
+                int address = addr[__builtin_ctz(here)];
+                laneVector* row = (laneVector*)(mem + address * SIMDLANES);
+                *row = blend(mask, reg[instr->regB], *row);
+                simd->pageLanes[address >> PAGESHIFT] |= here;
+                markWritten(&simd->written, address);
+            } else {
+                scatter(mem, addr, here, reg[instr->regB]);
+                for (laneMaskType rest = here; rest; rest &= rest - 1) {
+                    int lane = __builtin_ctz(rest);
+                    simd->pageLanes[addr[lane] >> PAGESHIFT] |= 1u << lane;
+                    markWritten(&simd->written, addr[lane]);
+                }
+            }
+            break;
+            case BEQ:
+            next += (reg[instr->regA] == reg[instr->regB]) & instr->offset;
+            break;
+            case HALT:
+            running &= ~here;
+            break;
+        }
+
+        pcs = blend(mask, next, pcs);
+        counts -= mask;
+        if (++steps == COUNTFLUSH) {
+            for (int lane = 0; lane < numLanes; lane++) executed[lane] += counts[lane];
+            counts = (laneVector){ 0 };
+            steps = 0;
+        }
+    }
+
+    storeLanes(simd, sims);
+    for (int lane = 0; lane < numLanes; lane++) {
+        simulatorType* sim = sims[lane];
+        if (sim->halted) continue;
+        for (int r = 0; r < NUMREGS; r++) sim->state.reg[r] = reg[r][lane];
+        sim->state.pc = pcs[lane];
+        sim->executed += executed[lane] + counts[lane];
+        sim->halted = 1;
+    }
+    return 0;
+}
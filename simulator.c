@@ -1,474 +1,311 @@
+/*
+ * Command-line driver for the LC2K pipeline simulator.
+ * Build: gcc -O2 -pthread -DCACHE_LIBRARY -o simulator simulator.c lc2ksim.c predictor.c counters.c profile.c dualissue.c ooo.c deep.c simd.c multicore.c cache.c hostprof.c memtrace.c -lm
+ * Add -DHOST_PROFILE to report where the simulator's own time goes, on stderr.
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Machine Definitions
-#define NUMMEMORY 65536 // maximum number of data words in memory
-#define NUMREGS 8 // number of machine registers
-
-#define ADD 0
-#define NOR 1
-#define LW 2
-#define SW 3
-#define BEQ 4
-#define JALR 5 // will not implemented for Project 3
-#define HALT 6
-#define NOOP 7
-
-const char* opcode_to_str_map[] = {
-    "add",
-    "nor",
-    "lw",
-    "sw",
-    "beq",
-    "jalr",
-    "halt",
-    "noop"
-};
-
-#define NOOPINSTR (NOOP << 22)
-
-typedef struct IFIDStruct {
-    int instr;
-	int pcPlus1;
-} IFIDType;
-
-typedef struct IDEXStruct {
-    int instr;
-	int pcPlus1;
-	int valA;
-	int valB;
-	int offset;
-} IDEXType;
-
-typedef struct EXMEMStruct {
-    int instr;
-	int branchTarget;
-    int eq;
-	int aluResult;
-	int valB;
-} EXMEMType;
+#include "hostprof.h"
+#include "lc2ksim.h"
+#include "memtrace.h"
 
-typedef struct MEMWBStruct {
-    int instr;
-	int writeData;
-} MEMWBType;
-
-typedef struct WBENDStruct {
-    int instr;
-	int writeData;
-} WBENDType;
-
-typedef struct stateStruct {
-    unsigned int numMemory;
-    unsigned int cycles; // number of cycles run so far
-	int pc;
-	int instrMem[NUMMEMORY];
-	int dataMem[NUMMEMORY];
-	int reg[NUMREGS];
-	IFIDType IFID;
-	IDEXType IDEX;
-	EXMEMType EXMEM;
-	MEMWBType MEMWB;
-	WBENDType WBEND;
-} stateType;
-
-static inline int opcode(int instruction) {
-    return instruction>>22;
-}
-
-static inline int field0(int instruction) {
-    return (instruction>>19) & 0x7;
-}
-
-static inline int field1(int instruction) {
-    return (instruction>>16) & 0x7;
-}
+#define OUTPUTBUFFERSIZE (1 << 20) // stdout buffer so tracing isn't bound by write calls
 
-static inline int field2(int instruction) {
-    return instruction & 0xFFFF;
+FILE* openOutput(const char* name){
+    // "-" is stdout; exits if the file can't be created
+    FILE* filePtr = strcmp(name, "-") ? fopen(name, "w") : stdout;
+    if (filePtr == NULL) {
+        printf("error: can't open file %s\n", name);
+        exit(1);
+    }
+    return filePtr;
 }
 
-// convert a 16-bit number into a 32-bit Linux integer
-static inline int convertNum(int num) {
-    return num - ( (num & (1<<15)) ? 1<<16 : 0 );
+void closeOutput(FILE* filePtr){
+    if (filePtr != NULL && filePtr != stdout) fclose(filePtr);
 }
 
-void printState(stateType*);
-void printInstruction(int);
-void readMachineCode(stateType*, char*);
-
-// HELPER FUNCTIONS
-int isReadInstr(int instr);
-int isWritingOpcode(int instr);
-void processField(int instr, int* valA, int* valB, int targetInstr, int writeData);
-void dataHazard(int* valA, int* valB, stateType* state);
-
-
-int main(int argc, char *argv[]) {
-
-    /* Declare state and newState.
-       Note these have static lifetime so that instrMem and
-       dataMem are not allocated on the stack. */
-
-    static stateType state, newState;
-
-    if (argc != 2) {
-        printf("error: usage: %s <machine-code file>\n", argv[0]);
+void runCores(const simulatorType* settings, int numCores, int arbitration, const char* fileName, int traceLevel){
+    // Runs <fileName> on <numCores> pipelines sharing one memory, then exits
+    multicoreType* multicore = multicoreCreate(numCores, settings);
+    if (multicore == NULL) {
+        printf("error: out of memory\n");
         exit(1);
     }
+    multicore->bus.arbitration = arbitration;
 
-    readMachineCode(&state, argv[1]);
-
-    /* ------------ Initialize State ------------ */
-
-    // INITIALIZE INSTRUCTIONS TO NOOP
-
-    state.IFID.instr = NOOPINSTR;
-    state.IDEX.instr = NOOPINSTR;
-    state.EXMEM.instr = NOOPINSTR;
-    state.MEMWB.instr = NOOPINSTR;
-    state.WBEND.instr = NOOPINSTR;
-
-    /* ------------------- END ------------------ */
-
-    newState = state;
-
-    while (opcode(state.MEMWB.instr) != HALT) {
-        printState(&state);
-
-        newState.cycles += 1;
-
-        /* ---------------------- IF stage --------------------- */
-
-        newState.IFID.instr = state.instrMem[state.pc];
-        newState.IFID.pcPlus1 = state.pc + 1;
-        newState.pc = state.pc + 1;
-
-        /* ---------------------- ID stage --------------------- */
-
-        int stalling = 0;
-
-        newState.IDEX.instr = state.IFID.instr;
-        newState.IDEX.valA = state.reg[field0(state.IFID.instr)];
-        newState.IDEX.valB = state.reg[field1(state.IFID.instr)];
-        newState.IDEX.offset = convertNum(field2(state.IFID.instr));
-        newState.IDEX.pcPlus1 = state.IFID.pcPlus1;
-
-        switch(opcode(state.IDEX.instr)){
-            case LW:
-            {
-                // Check if our current instruction relies on something loaded, and stall if it does
-                // We only care about field 0 if it's a load word, but all other fields if it isn't
-                stalling = opcode(state.IFID.instr) == LW ? field0(state.IFID.instr) == field1(state.IDEX.instr):((field0(state.IFID.instr) == field1(state.IDEX.instr)) || (field1(state.IFID.instr) == field1(state.IDEX.instr)));
-                if(stalling){
-                    // We need to stall
-                    newState.IDEX.instr = NOOPINSTR;
-                    newState.pc = state.pc;
-                    newState.IFID = state.IFID;
-                }
-                break;
-            }
-
-        }
-        
-        /* ---------------------- EX stage --------------------- */
-
-        int valA = state.IDEX.valA, valB = state.IDEX.valB; // Use variables in case of forwarding so as to not write to state
-
-        // Check for data hazards
-
-        dataHazard(&valA, &valB, &state);
-
-        
-        newState.EXMEM.valB = valB;
-        newState.EXMEM.branchTarget = state.IDEX.offset + state.IDEX.pcPlus1;
-
-        
-        switch(opcode(state.IDEX.instr)){
-            case LW:
-            case SW:
-            newState.EXMEM.aluResult = valA + state.IDEX.offset;
-            break;
-            case NOR:
-            newState.EXMEM.aluResult = ~(valA | valB);
-            break;
-            case ADD:
-            newState.EXMEM.aluResult = valA + valB;
-            break;
-        }
-
-        newState.EXMEM.eq = (valA == valB);
-
-        newState.EXMEM.instr = state.IDEX.instr;
-
-        /* --------------------- MEM stage --------------------- */
-
-        newState.MEMWB.instr = state.EXMEM.instr;
-
-        if(state.EXMEM.eq && (opcode(state.EXMEM.instr) == BEQ)){
-            // Set PC to branch target
-            newState.pc = state.EXMEM.branchTarget;
-            
-            // Squash
-            newState.IFID.instr = NOOPINSTR;
-            newState.IDEX.instr = NOOPINSTR;
-            newState.EXMEM.instr = NOOPINSTR;
-
-            newState.MEMWB.writeData = state.EXMEM.aluResult;
-        } else{
-            // Continue as normal
-
-            switch(opcode(state.EXMEM.instr)){
-                case LW:
-                newState.MEMWB.writeData = state.dataMem[state.EXMEM.aluResult];
-                break;
-                case SW:
-                newState.dataMem[state.EXMEM.aluResult] = state.EXMEM.valB;
-                newState.MEMWB.writeData = state.dataMem[state.EXMEM.aluResult];
-                break;
-                default:
-                newState.MEMWB.writeData = state.EXMEM.aluResult;
-                break;
-            }
-        }
-
-        /* ---------------------- WB stage --------------------- */
-
-        newState.WBEND.writeData = state.MEMWB.writeData;
-        newState.WBEND.instr = state.MEMWB.instr;
+    if (multicoreLoad(multicore, fileName)) {
+        printf("%s", multicore->error);
+        exit(1);
+    }
+    if (multicoreRun(multicore)) {
+        printf("%s", multicore->error);
+        exit(1);
+    }
 
-        switch(opcode(state.MEMWB.instr)){
-            case NOR:
-            case ADD:
-            newState.reg[field2(state.MEMWB.instr)] = state.MEMWB.writeData;
-            break;
-            case LW:
-            newState.reg[field1(state.MEMWB.instr)] = state.MEMWB.writeData;
-            break;
+    printf("Machine halted\n");
+    printMulticoreStats(multicore);
+    if (traceLevel != TRACE_NONE) {
+        for (int core = 0; core < numCores; core++) {
+            printf("Final state of core %d:\n", core);
+            printState(&multicore->cores[core]->state);
         }
-
-        /* ------------------------ END ------------------------ */
-        state = newState; /* this is the last statement before end of the loop. It marks the end
-        of the cycle and updates the current state with the values calculated in this cycle */
     }
-    printf("Machine halted\n");
-    printf("Total of %d cycles executed\n", state.cycles);
-    printf("Final state of machine:\n");
-    printState(&state);
-}
-
-int isReadInstr(int instr){
-    int opc = opcode(instr);
-    return (opc != JALR && opc != HALT && opc != NOOP);
-}
+    fflush(stdout);
 
-int isWritingOpcode(int instr){ // Return the field we want (1 = field1, 2 = field2)
-    int opc = opcode(instr);
-    return opc == LW ? 1 : ((opc == ADD || opc == NOR) ? 2:0);
+    multicoreDestroy(multicore);
+    exit(0);
 }
 
-void processField(int instr, int* valA, int* valB, int targetInstr, int writeData){
-    int field = isWritingOpcode(targetInstr);
-
-    switch(field){
-        case 1:
-        {
-            // Field 1, check if current instruction field0 or field1 rely on it
-            if(field0(instr) == field1(targetInstr)){
-                *valA = writeData;
-            }
-            if(field1(instr) == field1(targetInstr)){
-                *valB = writeData;
-            }
-            break;
-        }
-
-        case 2:
-        {
-            // Field 2, check if current instruction field0 or field1 rely on it
-            if(field0(instr) == field2(targetInstr)){
-                *valA = writeData;
-            }
-            if(field1(instr) == field2(targetInstr)){
-                *valB = writeData;
-            }
+int main(int argc, char *argv[]) {
+    static char outputBuffer[OUTPUTBUFFERSIZE];
+
+    char* fileName = NULL;
+    int traceLevel = TRACE_FULL;
+    int engine = ENGINE_PIPELINE;
+    int predictor = PREDICT_NONE;
+    int resolveStage = RESOLVE_MEM;
+    long long ffInstrs = -1; // -1 means no limit
+    int ffPc = -1; // -1 means no target pc
+    long long saveCycle = -1; // cycle to write a checkpoint at, -1 for none
+    char* saveName = NULL;
+    char* restoreName = NULL;
+    cacheConfigType icache = { 0 }, dcache = { 0 }; // no caches unless asked for
+    int memLatency = 0;
+    char* countersName = NULL; // JSON counters file, "-" for stdout
+    int sampleInterval = 0; // cycles between samples in the counters file, 0 for none
+    oooConfigType ooo = { 0 }; // fields left at 0 keep the engine's defaults
+    depthConfigType depth = { 0 }; // likewise
+    char* profileName = NULL; // per-pc report, "-" for stdout
+    char* foldedName = NULL; // the same as folded stacks
+    int numCores = 0; // 0 for the usual single machine
+    int arbitration = 1; // bus cycles per transaction before the transfer
+    char* memTraceName = NULL; // binary fetch and lw/sw trace
+
+    for (int arg = 1; arg < argc; arg++) {
+        if (!strcmp(argv[arg], "-t") && arg + 1 < argc) {
+            traceLevel = parseTraceLevel(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-e") && arg + 1 < argc) {
+            engine = parseEngine(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-b") && arg + 1 < argc) {
+            predictor = parsePredictor(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-f") && arg + 1 < argc) {
+            ffInstrs = strtoll(argv[++arg], NULL, 0);
+        } else if (!strcmp(argv[arg], "-p") && arg + 1 < argc) {
+            ffPc = strtol(argv[++arg], NULL, 0);
+        } else if (!strcmp(argv[arg], "-s") && arg + 2 < argc) {
+            saveCycle = strtoll(argv[++arg], NULL, 0);
+            saveName = argv[++arg];
+        } else if (!strcmp(argv[arg], "-br") && arg + 1 < argc) {
+            resolveStage = parseResolveStage(argv[++arg]);
+        } else if ((!strcmp(argv[arg], "-ic") || !strcmp(argv[arg], "-dc")) && arg + 3 < argc) {
+            cacheConfigType* config = argv[arg][1] == 'i' ? &icache : &dcache;
+            config->blockSize = atoi(argv[++arg]);
+            config->numSets = atoi(argv[++arg]);
+            config->blocksPerSet = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-l") && arg + 1 < argc) {
+            memLatency = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-rob") && arg + 1 < argc) {
+            ooo.robSize = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-rs") && arg + 1 < argc) {
+            ooo.rsSize = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-lsq") && arg + 1 < argc) {
+            ooo.lsqSize = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-w") && arg + 1 < argc) {
+            ooo.width = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-fu") && arg + 3 < argc) {
+            ooo.aluLatency = atoi(argv[++arg]);
+            ooo.loadLatency = atoi(argv[++arg]);
+            ooo.branchLatency = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-depth") && arg + 3 < argc) {
+            depth.fetchStages = atoi(argv[++arg]);
+            depth.executeStages = atoi(argv[++arg]);
+            depth.memoryStages = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-prof") && arg + 1 < argc) {
+            profileName = argv[++arg];
+        } else if (!strcmp(argv[arg], "-mt") && arg + 1 < argc) {
+            memTraceName = argv[++arg];
+        } else if (!strcmp(argv[arg], "-folded") && arg + 1 < argc) {
+            foldedName = argv[++arg];
+        } else if (!strcmp(argv[arg], "-c") && arg + 1 < argc) {
+            countersName = argv[++arg];
+        } else if (!strcmp(argv[arg], "-n") && arg + 1 < argc) {
+            sampleInterval = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-cores") && arg + 1 < argc) {
+            numCores = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-bus") && arg + 1 < argc) {
+            arbitration = atoi(argv[++arg]);
+        } else if (!strcmp(argv[arg], "-r") && arg + 1 < argc) {
+            restoreName = argv[++arg];
+        } else if (fileName == NULL) {
+            fileName = argv[arg];
+        } else {
+            fileName = NULL;
             break;
         }
     }
-}
 
-void dataHazard(int* valA, int* valB, stateType* state){
-    // Will process data hazard and forwarding (checks WBEND, MEMWB, then EXMEM writeDatas and formatting properly based on the current instruction)
-
-    int instr = state->IDEX.instr; // Since we will be checking in the IDEX stage
-
-    if(!isReadInstr(instr)) return; // If we don't care about data forwarding
-
-    processField(instr, valA, valB, state->WBEND.instr, state->WBEND.writeData);
-    processField(instr, valA, valB, state->MEMWB.instr, state->MEMWB.writeData);
-    processField(instr, valA, valB, state->EXMEM.instr, state->EXMEM.aluResult);
-}
+    if ((fileName == NULL) == (restoreName == NULL) || traceLevel < 0 || engine < 0 || predictor < 0 || resolveStage < 0 || memLatency < 0
+        || sampleInterval < 0 || (sampleInterval > 0 && countersName == NULL)
+        || ((saveName != NULL || restoreName != NULL || profileName != NULL || foldedName != NULL || memTraceName != NULL)
+            && engine != ENGINE_PIPELINE)
+        || (countersName != NULL && (engine == ENGINE_THREADED || engine == ENGINE_JIT || engine == ENGINE_SIMD))
+        || ((engine == ENGINE_DUAL || engine == ENGINE_OOO) // no caches, fixed resolution, no per-cycle sampling
+            && (icache.blockSize || dcache.blockSize || memLatency || resolveStage != RESOLVE_MEM || sampleInterval))
+        || (engine == ENGINE_DEEP && (icache.blockSize || dcache.blockSize || memLatency || sampleInterval))
+        || numCores < 0 || numCores > MAXCORES || arbitration < 0
+        || (numCores > 0 && (engine != ENGINE_PIPELINE || restoreName != NULL || saveName != NULL || countersName != NULL
+            || profileName != NULL || foldedName != NULL || memTraceName != NULL || ffInstrs >= 0 || ffPc >= 0))) {
+        printf("error: usage: %s [-t none|final|summary|full] [-e pipeline|threaded|jit|dual|ooo|simd|deep] [-cores <count> [-bus <arbitration cycles>]] [-rob <entries>] [-rs <entries>] [-lsq <entries>] [-w <width>] [-fu <alu> <load> <branch latency>] [-depth <IF> <EX> <MEM stages>] [-b none|backward|bimodal|gshare|tournament] [-br mem|ex|id] [-ic|-dc <blockSize> <numSets> <blocksPerSet>] [-l <memory latency>] [-c <counters file> [-n <sample cycles>]] [-prof <report file>] [-folded <stacks file>] [-mt <memory trace file>] [-f <instructions>] [-p <pc>] [-s <cycle> <checkpoint file>] <machine-code file> | -r <checkpoint file>\n", argv[0]);
+        exit(1);
+    }
 
-/*
-* DO NOT MODIFY ANY OF THE CODE BELOW.
-*/
+    setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
 
-void printInstruction(int instr) {
-    const char* instr_opcode_str;
-    int instr_opcode = opcode(instr);
-    if(ADD <= instr_opcode && instr_opcode <= NOOP) {
-        instr_opcode_str = opcode_to_str_map[instr_opcode];
+    simulatorType* sim = simulatorCreate();
+    if (sim == NULL) {
+        printf("error: out of memory\n");
+        exit(1);
     }
-
-    switch (instr_opcode) {
-        case ADD:
-        case NOR:
-        case LW:
-        case SW:
-        case BEQ:
-            printf("%s %d %d %d", instr_opcode_str, field0(instr), field1(instr), convertNum(field2(instr)));
-            break;
-        case JALR:
-            printf("%s %d %d", instr_opcode_str, field0(instr), field1(instr));
-            break;
-        case HALT:
-        case NOOP:
-            printf("%s", instr_opcode_str);
-            break;
-        default:
-            printf(".fill %d", instr);
-            return;
+    sim->traceLevel = traceLevel;
+    sim->engine = engine;
+    sim->predictor.kind = predictor;
+    sim->resolveStage = resolveStage;
+    sim->icacheConfig = icache;
+    sim->dcacheConfig = dcache;
+    sim->memLatency = memLatency;
+    if (ooo.robSize) sim->ooo.robSize = ooo.robSize;
+    if (ooo.rsSize) sim->ooo.rsSize = ooo.rsSize;
+    if (ooo.lsqSize) sim->ooo.lsqSize = ooo.lsqSize;
+    if (ooo.width) sim->ooo.width = ooo.width;
+    if (ooo.aluLatency) sim->ooo.aluLatency = ooo.aluLatency;
+    if (ooo.loadLatency) sim->ooo.loadLatency = ooo.loadLatency;
+    if (ooo.branchLatency) sim->ooo.branchLatency = ooo.branchLatency;
+    if (depth.fetchStages) sim->depth.fetchStages = depth.fetchStages;
+    if (depth.executeStages) sim->depth.executeStages = depth.executeStages;
+    if (depth.memoryStages) sim->depth.memoryStages = depth.memoryStages;
+
+    sim->profiling = profileName != NULL || foldedName != NULL;
+
+    if (numCores > 0) {
+        runCores(sim, numCores, arbitration, fileName, traceLevel);
     }
-}
-
-void printState(stateType *statePtr) {
-    printf("\n@@@\n");
-    printf("state before cycle %d starts:\n", statePtr->cycles);
-    printf("\tpc = %d\n", statePtr->pc);
 
-    printf("\tdata memory:\n");
-    for (int i=0; i<statePtr->numMemory; ++i) {
-        printf("\t\tdataMem[ %d ] = 0x%08X\n", i, statePtr->dataMem[i]);
+    FILE* countersFile = NULL;
+    if (countersName != NULL) {
+        countersFile = openOutput(countersName);
+        if (sampleInterval > 0) {
+            sim->sampleFile = countersFile;
+            sim->sampleInterval = sampleInterval;
+        }
     }
-    printf("\tregisters:\n");
-    for (int i=0; i<NUMREGS; ++i) {
-        printf("\t\treg[ %d ] = %d\n", i, statePtr->reg[i]);
+
+    if (restoreName != NULL ? simulatorRestore(sim, restoreName) : simulatorLoad(sim, fileName)) {
+        printf("%s", sim->error);
+        exit(1);
     }
 
-    // IF/ID
-    printf("\tIF/ID pipeline register:\n");
-    printf("\t\tinstruction = 0x%08X ( ", statePtr->IFID.instr);
-    printInstruction(statePtr->IFID.instr);
-    printf(" )\n");
-    printf("\t\tpcPlus1 = %d", statePtr->IFID.pcPlus1);
-    if(opcode(statePtr->IFID.instr) == NOOP){
-        printf(" (Don't Care)");
+    if (engine != ENGINE_THREADED && engine != ENGINE_JIT && engine != ENGINE_SIMD && (ffInstrs >= 0 || ffPc >= 0)) {
+        // Run functionally up to the region we care about, then hand the
+        // architectural state to the pipeline with every latch holding a noop
+        long long executed = simulatorFastForward(sim, ffInstrs, ffPc);
+        if (traceLevel != TRACE_NONE) {
+            printf("fast-forwarded %lld instructions to pc %d\n", executed, sim->state.pc);
+        }
     }
-    printf("\n");
-    
-    // ID/EX
-    int idexOp = opcode(statePtr->IDEX.instr);
-    printf("\tID/EX pipeline register:\n");
-    printf("\t\tinstruction = 0x%08X ( ", statePtr->IDEX.instr);
-    printInstruction(statePtr->IDEX.instr);
-    printf(" )\n");
-    printf("\t\tpcPlus1 = %d", statePtr->IDEX.pcPlus1);
-    if(idexOp == NOOP){
-        printf(" (Don't Care)");
+
+    if (memTraceName != NULL) {
+        // Fast-forwarded instructions aren't traced: only the pipeline's own accesses are
+        sim->memTrace = memTraceOpen(memTraceName);
+        if (sim->memTrace == NULL) {
+            printf("error: can't open file %s\n", memTraceName);
+            exit(1);
+        }
     }
-    printf("\n");
-    printf("\t\treadRegA = %d", statePtr->IDEX.valA);
-    if (idexOp >= HALT || idexOp < 0) {
-        printf(" (Don't Care)");
+
+    if (saveName != NULL) {
+        // Run up to the requested cycle (or halt), write the checkpoint, then carry on
+        int status = 0;
+        while (sim->state.cycles < saveCycle && !(status = simulatorStep(sim)));
+        if (status < 0 || simulatorSave(sim, saveName)) {
+            printf("%s", sim->error);
+            exit(1);
+        }
+        if (traceLevel != TRACE_NONE) {
+            printf("checkpoint written at cycle %d to %s\n", sim->state.cycles, saveName);
+        }
     }
-    printf("\n");
-    printf("\t\treadRegB = %d", statePtr->IDEX.valB);
-    if(idexOp == LW || idexOp > BEQ || idexOp < 0) {
-        printf(" (Don't Care)");
+
+    if (simulatorRun(sim)) {
+        printf("%s", sim->error);
+        exit(1);
     }
-    printf("\n");
-    printf("\t\toffset = %d", statePtr->IDEX.offset);
-    if (idexOp != LW && idexOp != SW && idexOp != BEQ) {
-        printf(" (Don't Care)");
+    if (sim->memTrace != NULL && memTraceClose(sim->memTrace)) {
+        printf("error: can't write file %s\n", memTraceName);
+        exit(1);
     }
-    printf("\n");
+    sim->memTrace = NULL;
 
-    // EX/MEM
-    int exmemOp = opcode(statePtr->EXMEM.instr);
-    printf("\tEX/MEM pipeline register:\n");
-    printf("\t\tinstruction = 0x%08X ( ", statePtr->EXMEM.instr);
-    printInstruction(statePtr->EXMEM.instr);
-    printf(" )\n");
-    printf("\t\tbranchTarget %d", statePtr->EXMEM.branchTarget);
-    if (exmemOp != BEQ) {
-        printf(" (Don't Care)");
-    }
-    printf("\n");
-    printf("\t\teq ? %s", (statePtr->EXMEM.eq ? "True" : "False"));
-    if (exmemOp != BEQ) {
-        printf(" (Don't Care)");
+    printf("Machine halted\n");
+    if (engine == ENGINE_PIPELINE) {
+        printf("Total of %d cycles executed\n", sim->state.cycles);
+        if (predictor != PREDICT_NONE) {
+            printPredictorStats(&sim->predictor);
+        }
+        if (sim->icache != NULL) cache_instance_print_stats(sim->icache, "I-cache");
+        if (sim->dcache != NULL) cache_instance_print_stats(sim->dcache, "D-cache");
+        if (sim->icache != NULL || sim->dcache != NULL) {
+            printf("Memory stalls: %lld cycles\n", sim->memStallCycles);
+        }
+    } else if (engine == ENGINE_DUAL || engine == ENGINE_OOO || engine == ENGINE_DEEP) {
+        printf("Total of %d cycles executed\n", sim->state.cycles);
+        printf("%lld instructions, IPC %.3f", sim->counters.retired,
+            sim->state.cycles ? (double)sim->counters.retired / sim->state.cycles : 0.0);
+        if (engine == ENGINE_DUAL) {
+            printf(", %lld dual-issue cycles\n", sim->counters.dualIssues);
+        } else if (engine == ENGINE_DEEP) {
+            printf(", %lld load-use and %lld ALU-use stalls, %lld branch stalls, %lld squashed slots\n",
+                sim->counters.loadUseStalls, sim->counters.aluUseStalls, sim->counters.branchStalls, sim->counters.squashedSlots);
+        } else {
+            printf(", %lld ROB-full cycles, %lld store-to-load forwards\n", sim->counters.robFullStalls, sim->counters.storeForwards);
+        }
+        if (predictor != PREDICT_NONE) {
+            printPredictorStats(&sim->predictor);
+        }
+    } else {
+        printf("Total of %lld instructions executed\n", sim->executed);
     }
-    printf("\n");
-    printf("\t\taluResult = %d", statePtr->EXMEM.aluResult);
-    if (exmemOp > SW || exmemOp < 0) {
-        printf(" (Don't Care)");
+    if (traceLevel != TRACE_NONE) {
+        printf("Final state of machine:\n");
+        HOST_TIMER_START(printTimer);
+        printState(&sim->state);
+        HOST_TIMER_LAP(printTimer, HOST_PRINTSTATE);
     }
-    printf("\n");
-    printf("\t\treadRegB = %d", statePtr->EXMEM.valB);
-    if (exmemOp != SW) {
-        printf(" (Don't Care)");
+    if (countersFile != NULL) {
+        printCountersJson(countersFile, sim);
+        closeOutput(countersFile);
     }
-    printf("\n");
-
-    // MEM/WB
-	int memwbOp = opcode(statePtr->MEMWB.instr);
-    printf("\tMEM/WB pipeline register:\n");
-    printf("\t\tinstruction = 0x%08X ( ", statePtr->MEMWB.instr);
-    printInstruction(statePtr->MEMWB.instr);
-    printf(" )\n");
-    printf("\t\twriteData = %d", statePtr->MEMWB.writeData);
-    if (memwbOp >= SW || memwbOp < 0) {
-        printf(" (Don't Care)");
+    if (profileName != NULL) {
+        FILE* profileFile = openOutput(profileName);
+        printProfile(profileFile, sim);
+        closeOutput(profileFile);
     }
-    printf("\n");     
-
-    // WB/END
-	int wbendOp = opcode(statePtr->WBEND.instr);
-    printf("\tWB/END pipeline register:\n");
-    printf("\t\tinstruction = 0x%08X ( ", statePtr->WBEND.instr);
-    printInstruction(statePtr->WBEND.instr);
-    printf(" )\n");
-    printf("\t\twriteData = %d", statePtr->WBEND.writeData);
-    if (wbendOp >= SW || wbendOp < 0) {
-        printf(" (Don't Care)");
+    if (foldedName != NULL) {
+        // Flame graphs get the program's file name as their root frame
+        const char* programName = fileName != NULL ? fileName : restoreName;
+        const char* slash = strrchr(programName, '/');
+        FILE* foldedFile = openOutput(foldedName);
+        printFoldedProfile(foldedFile, sim, slash != NULL ? slash + 1 : programName);
+        closeOutput(foldedFile);
     }
-    printf("\n");
-
-    printf("end state\n");
     fflush(stdout);
-}
-
-// File
-#define MAXLINELENGTH 1000 // MAXLINELENGTH is the max number of characters we read
+#ifdef HOST_PROFILE
+    printHostProfile(stderr, sim->state.cycles);
+#endif
 
-void readMachineCode(stateType *state, char* filename) {
-    char line[MAXLINELENGTH];
-    FILE *filePtr = fopen(filename, "r");
-    if (filePtr == NULL) {
-        printf("error: can't open file %s", filename);
-        exit(1);
-    }
-
-    printf("instruction memory:\n");
-    for (state->numMemory = 0; fgets(line, MAXLINELENGTH, filePtr) != NULL; ++state->numMemory) {
-        if (sscanf(line, "%x", state->instrMem+state->numMemory) != 1) {
-            printf("error in reading address %d\n", state->numMemory);
-            exit(1);
-        }
-        printf("\tinstrMem[ %d ] = 0x%08X ( ", state->numMemory, 
-            state->instrMem[state->numMemory]);
-        printInstruction(state->dataMem[state->numMemory] = state->instrMem[state->numMemory]);
-        printf(" )\n");
-    }
+    simulatorDestroy(sim);
+    return 0;
 }